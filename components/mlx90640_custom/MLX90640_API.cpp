@@ -16,6 +16,7 @@
  */
 #include "MLX90640_I2C_Driver.h"
 #include "MLX90640_API.h"
+#include "MLX90640_Vector.h"
 #include <math.h>
 
 static void ExtractVDDParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
@@ -37,7 +38,39 @@ static float GetMedian(float *values, int n);
 static int IsPixelBad(uint16_t pixel,paramsMLX90640 *params);
 static int ValidateFrameData(uint16_t *frameData);
 static int ValidateAuxData(uint16_t *auxData);
+static uint32_t ISqrt64(uint64_t x);
+static int32_t FourthRootQ16(int64_t x);
+static int64_t DivideQ24(int64_t value, int32_t denomQ24);
+static float FastFourthRoot(float x, int iterations);
   
+// Live pixels of each subpage, indexed [chess mode][subpage]. Built at compile
+// time so the kernels never evaluate the pattern divisions at run time.
+typedef struct
+    {
+        pixelMLX90640 list[2][2][MLX90640_SUBPAGE_PIXEL_NUM];
+    } subPagePixelsMLX90640;
+
+static constexpr subPagePixelsMLX90640 BuildSubPagePixels()
+{
+    subPagePixelsMLX90640 pixels = {};
+    int count[2][2] = {};
+
+    for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_NUM; pixelNumber++)
+    {
+        int8_t ilPattern = pixelNumber / 32 - (pixelNumber / 64) * 2;
+        int8_t chessPattern = ilPattern ^ (pixelNumber - (pixelNumber/2)*2);
+        int8_t conversionPattern = ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 + (pixelNumber + 1) / 4 - pixelNumber / 4) * (1 - 2 * ilPattern);
+        pixelMLX90640 entry = {(uint16_t)pixelNumber, ilPattern, conversionPattern};
+
+        pixels.list[0][ilPattern][count[0][ilPattern]++] = entry;
+        pixels.list[1][chessPattern][count[1][chessPattern]++] = entry;
+    }
+
+    return pixels;
+}
+
+static constexpr subPagePixelsMLX90640 subPagePixels = BuildSubPagePixels();
+
 int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData)
 {
      return MLX90640_I2CRead(slaveAddr, MLX90640_EEPROM_START_ADDRESS, MLX90640_EEPROM_DUMP_NUM, eeData);
@@ -113,24 +146,50 @@ int MLX90640_TriggerMeasurement(uint8_t slaveAddr)
     
 int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData)
 {
-    uint16_t dataReady = 0;
-    uint16_t controlRegister1;
     uint16_t statusRegister;
-    int error = 1;
-    uint16_t data[64];
-    uint8_t cnt = 0;
+    int error = 0;
     
-    while(dataReady == 0)
+    while(error == 0)
     {
-        error = MLX90640_I2CRead(slaveAddr, MLX90640_STATUS_REG, 1, &statusRegister);
-        if(error != MLX90640_NO_ERROR)
+        error = MLX90640_GetDataReady(slaveAddr, &statusRegister);
+        if(error < 0)
         {
             return error;
         }    
-        //dataReady = statusRegister & 0x0008;
-        dataReady = MLX90640_GET_DATA_READY(statusRegister); 
     }      
     
+    error = MLX90640_ReadPixelData(slaveAddr, statusRegister, frameData);
+    if(error != MLX90640_NO_ERROR)
+    {
+        return error;
+    }                       
+    
+    return MLX90640_ReadAuxData(slaveAddr, frameData);    
+}
+
+//------------------------------------------------------------------------------
+
+// Non-blocking pieces of MLX90640_GetFrameData, for callers that poll from a
+// scheduler: MLX90640_GetDataReady until it returns 1, then
+// MLX90640_ReadPixelData and MLX90640_ReadAuxData with the same frameData.
+
+int MLX90640_GetDataReady(uint8_t slaveAddr, uint16_t *statusRegister)
+{
+    int error;
+    
+    error = MLX90640_I2CRead(slaveAddr, MLX90640_STATUS_REG, 1, statusRegister);
+    if(error != MLX90640_NO_ERROR)
+    {
+        return error;
+    }    
+    
+    return MLX90640_GET_DATA_READY(*statusRegister) != 0;
+}
+
+int MLX90640_ReadPixelData(uint8_t slaveAddr, uint16_t statusRegister, uint16_t *frameData)
+{
+    int error;
+    
     error = MLX90640_I2CWrite(slaveAddr, MLX90640_STATUS_REG, MLX90640_INIT_STATUS_VALUE);
     if(error == -MLX90640_I2C_NACK_ERROR)
     {
@@ -143,6 +202,49 @@ int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData)
         return error;
     }                       
     
+    //frameData[833] = statusRegister & 0x0001;
+    frameData[833] = MLX90640_GET_FRAME(statusRegister);
+    
+    return MLX90640_NO_ERROR;
+}
+
+// Interleaved-mode variant of MLX90640_ReadPixelData: each subpage only
+// refreshes every other row, so only those 12 rows are read. The other rows
+// keep their previous contents, which the To and image kernels never touch
+// for this subpage, so the frameData layout is unchanged.
+int MLX90640_ReadSubPagePixelData(uint8_t slaveAddr, uint16_t statusRegister, uint16_t *frameData)
+{
+    int error;
+    uint16_t subPage;
+    
+    error = MLX90640_I2CWrite(slaveAddr, MLX90640_STATUS_REG, MLX90640_INIT_STATUS_VALUE);
+    if(error == -MLX90640_I2C_NACK_ERROR)
+    {
+        return error;
+    }
+    
+    subPage = MLX90640_GET_FRAME(statusRegister);
+    for(int line = subPage; line < MLX90640_LINE_NUM; line += 2)
+    {
+        error = MLX90640_I2CRead(slaveAddr, MLX90640_PIXEL_DATA_START_ADDRESS + line * MLX90640_LINE_SIZE, MLX90640_LINE_SIZE, &frameData[line * MLX90640_LINE_SIZE]); 
+        if(error != MLX90640_NO_ERROR)
+        {
+            return error;
+        }                       
+    }
+    
+    frameData[833] = subPage;
+    
+    return MLX90640_NO_ERROR;
+}
+
+int MLX90640_ReadAuxData(uint8_t slaveAddr, uint16_t *frameData)
+{
+    uint16_t controlRegister1;
+    int error = 1;
+    uint16_t data[64];
+    uint8_t cnt = 0;
+    
     error = MLX90640_I2CRead(slaveAddr, MLX90640_AUX_DATA_START_ADDRESS, MLX90640_AUX_NUM, data); 
     if(error != MLX90640_NO_ERROR)
     {
@@ -152,8 +254,6 @@ int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData)
         
     error = MLX90640_I2CRead(slaveAddr, MLX90640_CTRL_REG, 1, &controlRegister1);
     frameData[832] = controlRegister1;
-    //frameData[833] = statusRegister & 0x0001;
-    frameData[833] = MLX90640_GET_FRAME(statusRegister);
     
     if(error != MLX90640_NO_ERROR)
     {
@@ -255,6 +355,112 @@ int MLX90640_ExtractParameters(uint16_t *eeData, paramsMLX90640 *mlx90640)
 
 //------------------------------------------------------------------------------
 
+void MLX90640_CompileParameters(const paramsMLX90640 *params, compiledMLX90640 *compiled)
+{
+    float ktaScale;
+    float kvScale;
+    float alphaScale;
+
+    ktaScale = 1.0f / POW2(params->ktaScale);
+    kvScale = 1.0f / POW2(params->kvScale);
+    alphaScale = 1.0f / (SCALEALPHA * POW2(params->alphaScale));
+
+    for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_NUM; pixelNumber++)
+    {
+        compiled->kta[pixelNumber] = params->kta[pixelNumber] * ktaScale;
+        compiled->kv[pixelNumber] = params->kv[pixelNumber] * kvScale;
+        compiled->offset[pixelNumber] = params->offset[pixelNumber];
+        compiled->alphaRecip[pixelNumber] = params->alpha[pixelNumber] * alphaScale;
+    }
+
+    compiled->alphaCorrR[0] = 1 / (1 + params->ksTo[0] * 40);
+    compiled->alphaCorrR[1] = 1 ;
+    compiled->alphaCorrR[2] = (1 + params->ksTo[1] * params->ct[2]);
+    compiled->alphaCorrR[3] = compiled->alphaCorrR[2] * (1 + params->ksTo[2] * (params->ct[3] - params->ct[2]));
+
+    for(int range = 0; range < 4; range++)
+    {
+        compiled->ksTo[range] = params->ksTo[range];
+        compiled->ct[range] = params->ct[range];
+    }
+
+    compiled->roughBase = 1 - params->ksTo[1] * 273.15f;
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_CompileFixedParameters(const paramsMLX90640 *params, fixedMLX90640 *fixed)
+{
+    float alphaCorrR[4];
+
+    alphaCorrR[0] = 1 / (1 + params->ksTo[0] * 40);
+    alphaCorrR[1] = 1 ;
+    alphaCorrR[2] = (1 + params->ksTo[1] * params->ct[2]);
+    alphaCorrR[3] = alphaCorrR[2] * (1 + params->ksTo[2] * (params->ct[3] - params->ct[2]));
+
+    for(int range = 0; range < 4; range++)
+    {
+        fixed->alphaCorrRQ24[range] = lroundf(alphaCorrR[range] * 16777216.0f);
+        fixed->ksToQ30[range] = lround(params->ksTo[range] * 1073741824.0);
+        fixed->ctQ16[range] = (int32_t)params->ct[range] * 65536;
+    }
+
+    fixed->roughBaseQ24 = lround((1 - params->ksTo[1] * 273.15) * 16777216.0);
+    fixed->ilChessC1Q8 = lroundf(params->ilChessC[1] * 256.0f);
+    fixed->ilChessC2Q8 = lroundf(params->ilChessC[2] * 256.0f);
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_CompileVectorParameters(const paramsMLX90640 *params, uint8_t mode, vectorMLX90640 *vector)
+{
+    float ktaScale;
+    float kvScale;
+    float alphaScale;
+    const pixelMLX90640 *pixels;
+    uint16_t pixelNumber;
+
+    ktaScale = 1.0f / POW2(params->ktaScale);
+    kvScale = 1.0f / POW2(params->kvScale);
+    alphaScale = 1.0f / (SCALEALPHA * POW2(params->alphaScale));
+
+    for(int subPage = 0; subPage < 2; subPage++)
+    {
+        pixels = MLX90640_GetSubPagePixels(mode, subPage);
+        for(int i = 0; i < MLX90640_SUBPAGE_PIXEL_NUM; i++)
+        {
+            pixelNumber = pixels[i].pixel;
+
+            vector->pixel[subPage][i] = pixelNumber;
+            vector->offset[subPage][i] = params->offset[pixelNumber];
+            vector->kta[subPage][i] = params->kta[pixelNumber] * ktaScale;
+            vector->kv[subPage][i] = params->kv[pixelNumber] * kvScale;
+            vector->alphaRecip[subPage][i] = params->alpha[pixelNumber] * alphaScale;
+            vector->ilChess[subPage][i] = 0;
+            if(mode != params->calibrationModeEE)
+            {
+                vector->ilChess[subPage][i] = params->ilChessC[2] * (2 * pixels[i].ilPattern - 1) - params->ilChessC[1] * pixels[i].conversionPattern;
+            }
+        }
+    }
+
+    vector->alphaCorrR[0] = 1 / (1 + params->ksTo[0] * 40);
+    vector->alphaCorrR[1] = 1 ;
+    vector->alphaCorrR[2] = (1 + params->ksTo[1] * params->ct[2]);
+    vector->alphaCorrR[3] = vector->alphaCorrR[2] * (1 + params->ksTo[2] * (params->ct[3] - params->ct[2]));
+
+    for(int range = 0; range < 4; range++)
+    {
+        vector->ksTo[range] = params->ksTo[range];
+        vector->ct[range] = params->ct[range];
+    }
+
+    vector->roughBase = 1 - params->ksTo[1] * 273.15f;
+    vector->mode = mode;
+}
+
+//------------------------------------------------------------------------------
+
 int MLX90640_SetResolution(uint8_t slaveAddr, uint8_t resolution)
 {
     uint16_t controlRegister1;
@@ -404,9 +610,9 @@ void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params, flo
     float irData;
     float alphaCompensated;
     uint8_t mode;
+    const pixelMLX90640 *pixels;
+    uint16_t pixelNumber;
     int8_t ilPattern;
-    int8_t chessPattern;
-    int8_t pattern;
     int8_t conversionPattern;
     float Sx;
     float To;
@@ -460,67 +666,565 @@ void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params, flo
       irDataCP[1] = irDataCP[1] - (params->cpOffset[1] + params->ilChessC[0]) * (1 + params->cpKta * (ta - 25)) * (1 + params->cpKv * (vdd - 3.3));
     }
 
-    for( int pixelNumber = 0; pixelNumber < 768; pixelNumber++)
+    pixels = MLX90640_GetSubPagePixels(mode, subPage);
+    for( int i = 0; i < MLX90640_SUBPAGE_PIXEL_NUM; i++)
     {
-        ilPattern = pixelNumber / 32 - (pixelNumber / 64) * 2; 
-        chessPattern = ilPattern ^ (pixelNumber - (pixelNumber/2)*2); 
-        conversionPattern = ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 + (pixelNumber + 1) / 4 - pixelNumber / 4) * (1 - 2 * ilPattern);
+        pixelNumber = pixels[i].pixel;
+        ilPattern = pixels[i].ilPattern;
+        conversionPattern = pixels[i].conversionPattern;
+
+        irData = (int16_t)frameData[pixelNumber] * gain;
+        
+        kta = params->kta[pixelNumber]/ktaScale;
+        kv = params->kv[pixelNumber]/kvScale;
+        irData = irData - params->offset[pixelNumber]*(1 + kta*(ta - 25))*(1 + kv*(vdd - 3.3));
+        
+        if(mode !=  params->calibrationModeEE)
+        {
+          irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) - params->ilChessC[1] * conversionPattern; 
+        }                       
+
+        irData = irData - params->tgc * irDataCP[subPage];
+        irData = irData / emissivity;
+        
+        alphaCompensated = SCALEALPHA*alphaScale/params->alpha[pixelNumber];
+        alphaCompensated = alphaCompensated*(1 + params->KsTa * (ta - 25));
+                    
+        Sx = alphaCompensated * alphaCompensated * alphaCompensated * (irData + alphaCompensated * taTr);
+        Sx = sqrt(sqrt(Sx)) * params->ksTo[1];            
         
-        if(mode == 0)
+        To = sqrt(sqrt(irData/(alphaCompensated * (1 - params->ksTo[1] * 273.15) + Sx) + taTr)) - 273.15;                     
+                
+        if(To < params->ct[1])
         {
-          pattern = ilPattern; 
+            range = 0;
         }
-        else 
+        else if(To < params->ct[2])   
+        {
+            range = 1;            
+        }   
+        else if(To < params->ct[3])
         {
-          pattern = chessPattern; 
-        }               
+            range = 2;            
+        }
+        else
+        {
+            range = 3;            
+        }      
         
-        if(pattern == frameData[833])
-        {    
-            irData = (int16_t)frameData[pixelNumber] * gain;
-            
-            kta = params->kta[pixelNumber]/ktaScale;
-            kv = params->kv[pixelNumber]/kvScale;
-            irData = irData - params->offset[pixelNumber]*(1 + kta*(ta - 25))*(1 + kv*(vdd - 3.3));
-            
-            if(mode !=  params->calibrationModeEE)
-            {
-              irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) - params->ilChessC[1] * conversionPattern; 
-            }                       
-    
-            irData = irData - params->tgc * irDataCP[subPage];
-            irData = irData / emissivity;
-            
-            alphaCompensated = SCALEALPHA*alphaScale/params->alpha[pixelNumber];
-            alphaCompensated = alphaCompensated*(1 + params->KsTa * (ta - 25));
-                        
-            Sx = alphaCompensated * alphaCompensated * alphaCompensated * (irData + alphaCompensated * taTr);
-            Sx = sqrt(sqrt(Sx)) * params->ksTo[1];            
-            
-            To = sqrt(sqrt(irData/(alphaCompensated * (1 - params->ksTo[1] * 273.15) + Sx) + taTr)) - 273.15;                     
+        To = sqrt(sqrt(irData / (alphaCompensated * alphaCorrR[range] * (1 + params->ksTo[range] * (To - params->ct[range]))) + taTr)) - 273.15;
                     
-            if(To < params->ct[1])
-            {
-                range = 0;
-            }
-            else if(To < params->ct[2])   
-            {
-                range = 1;            
-            }   
-            else if(To < params->ct[3])
-            {
-                range = 2;            
-            }
-            else
-            {
-                range = 3;            
-            }      
-            
-            To = sqrt(sqrt(irData / (alphaCompensated * alphaCorrR[range] * (1 + params->ksTo[range] * (To - params->ct[range]))) + taTr)) - 273.15;
-                        
-            result[pixelNumber] = To;
+        result[pixelNumber] = To;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Same result as MLX90640_CalculateTo, rewritten around S = irData / alphaCompensated:
+//   Sx / alphaCompensated = ksTo[1] * (S + taTr)^(1/4)
+// so every per-pixel scale, the emissivity and the KsTa term fold into
+// alphaRecip[i] * sScale, and only two divisions remain per pixel. The
+// reordering only costs float rounding: within 0.0005 degC of
+// MLX90640_CalculateTo from -40 to 300 degC (tests/mlx90640_custom).
+void MLX90640_CalculateToCompiled(uint16_t *frameData, const paramsMLX90640 *params, const compiledMLX90640 *compiled, float emissivity, float tr, float *result)
+{
+    float vdd;
+    float ta;
+    float ta4;
+    float tr4;
+    float taTr;
+    float gain;
+    float irDataCP[2];
+    float irData;
+    float dTa;
+    float dVdd;
+    float sScale;
+    float tgcCP;
+    float S;
+    float R0;
+    uint8_t mode;
+    const pixelMLX90640 *pixels;
+    uint16_t pixelNumber;
+    int8_t ilPattern;
+    int8_t conversionPattern;
+    float To;
+    int8_t range;
+    uint16_t subPage;
+
+    subPage = frameData[833];
+    vdd = MLX90640_GetVdd(frameData, params);
+    ta = MLX90640_GetTa(frameData, params);
+
+    ta4 = (ta + 273.15f);
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    tr4 = (tr + 273.15f);
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
+    taTr = tr4 - (tr4-ta4)/emissivity;
+
+    dTa = ta - 25;
+    dVdd = vdd - 3.3f;
+
+//------------------------- Per-frame reciprocals ------------------------------
+
+    gain = (float)params->gainEE / (int16_t)frameData[778];
+    sScale = 1.0f / (emissivity * (1 + params->KsTa * dTa));
+
+    mode = (frameData[832] & MLX90640_CTRL_MEAS_MODE_MASK) >> 5;
+
+    irDataCP[0] = (int16_t)frameData[776] * gain;
+    irDataCP[1] = (int16_t)frameData[808] * gain;
+
+    irDataCP[0] = irDataCP[0] - params->cpOffset[0] * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    if( mode ==  params->calibrationModeEE)
+    {
+        irDataCP[1] = irDataCP[1] - params->cpOffset[1] * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    }
+    else
+    {
+      irDataCP[1] = irDataCP[1] - (params->cpOffset[1] + params->ilChessC[0]) * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    }
+    tgcCP = params->tgc * irDataCP[subPage];
+
+//------------------------- To calculation -------------------------------------
+
+    pixels = MLX90640_GetSubPagePixels(mode, subPage);
+    for( int i = 0; i < MLX90640_SUBPAGE_PIXEL_NUM; i++)
+    {
+        pixelNumber = pixels[i].pixel;
+        ilPattern = pixels[i].ilPattern;
+        conversionPattern = pixels[i].conversionPattern;
+
+        irData = (int16_t)frameData[pixelNumber] * gain;
+        irData = irData - compiled->offset[pixelNumber]*(1 + compiled->kta[pixelNumber]*dTa)*(1 + compiled->kv[pixelNumber]*dVdd);
+
+        if(mode !=  params->calibrationModeEE)
+        {
+          irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) - params->ilChessC[1] * conversionPattern;
+        }
+
+        irData = irData - tgcCP;
+        S = irData * compiled->alphaRecip[pixelNumber] * sScale;
+
+        R0 = sqrtf(sqrtf(S + taTr));
+        To = sqrtf(sqrtf(S / (compiled->roughBase + compiled->ksTo[1] * R0) + taTr)) - 273.15f;
+
+        if(To < compiled->ct[1])
+        {
+            range = 0;
+        }
+        else if(To < compiled->ct[2])
+        {
+            range = 1;
+        }
+        else if(To < compiled->ct[3])
+        {
+            range = 2;
+        }
+        else
+        {
+            range = 3;
+        }
+
+        To = sqrtf(sqrtf(S / (compiled->alphaCorrR[range] * (1 + compiled->ksTo[range] * (To - compiled->ct[range]))) + taTr)) - 273.15f;
+
+        result[pixelNumber] = To;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Reduced-precision variant of MLX90640_CalculateToCompiled. Every fourth
+// root is a bit-level seed refined by two Newton steps, with no sqrt or pow
+// calls. All three roots of the reference stay: the rough To is needed for
+// its value in the ksTo slope term, not only to pick the range, and its inner
+// root needs both steps too, as its error reaches To through ksTo and grows
+// with the slope. Against MLX90640_CalculateTo the result stays within 0.03 degC from
+// -40 to 300 degC, for ksTo down to -0.0012 (tests/mlx90640_custom).
+void MLX90640_CalculateToFast(uint16_t *frameData, const paramsMLX90640 *params, const compiledMLX90640 *compiled, float emissivity, float tr, float *result)
+{
+    float vdd;
+    float ta;
+    float ta4;
+    float tr4;
+    float taTr;
+    float gain;
+    float irDataCP[2];
+    float irData;
+    float dTa;
+    float dVdd;
+    float sScale;
+    float tgcCP;
+    float S;
+    float R0;
+    uint8_t mode;
+    const pixelMLX90640 *pixels;
+    uint16_t pixelNumber;
+    float To;
+    int8_t range;
+    uint16_t subPage;
+
+    subPage = frameData[833];
+    vdd = MLX90640_GetVdd(frameData, params);
+    ta = MLX90640_GetTa(frameData, params);
+
+    ta4 = (ta + 273.15f);
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    tr4 = (tr + 273.15f);
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
+    taTr = tr4 - (tr4-ta4)/emissivity;
+
+    dTa = ta - 25;
+    dVdd = vdd - 3.3f;
+
+//------------------------- Per-frame reciprocals ------------------------------
+
+    gain = (float)params->gainEE / (int16_t)frameData[778];
+    sScale = 1.0f / (emissivity * (1 + params->KsTa * dTa));
+
+    mode = (frameData[832] & MLX90640_CTRL_MEAS_MODE_MASK) >> 5;
+
+    irDataCP[0] = (int16_t)frameData[776] * gain;
+    irDataCP[1] = (int16_t)frameData[808] * gain;
+
+    irDataCP[0] = irDataCP[0] - params->cpOffset[0] * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    if( mode ==  params->calibrationModeEE)
+    {
+        irDataCP[1] = irDataCP[1] - params->cpOffset[1] * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    }
+    else
+    {
+      irDataCP[1] = irDataCP[1] - (params->cpOffset[1] + params->ilChessC[0]) * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    }
+    tgcCP = params->tgc * irDataCP[subPage];
+
+//------------------------- To calculation -------------------------------------
+
+    pixels = MLX90640_GetSubPagePixels(mode, subPage);
+    for( int i = 0; i < MLX90640_SUBPAGE_PIXEL_NUM; i++)
+    {
+        pixelNumber = pixels[i].pixel;
+
+        irData = (int16_t)frameData[pixelNumber] * gain;
+        irData = irData - compiled->offset[pixelNumber]*(1 + compiled->kta[pixelNumber]*dTa)*(1 + compiled->kv[pixelNumber]*dVdd);
+
+        if(mode !=  params->calibrationModeEE)
+        {
+          irData = irData + params->ilChessC[2] * (2 * pixels[i].ilPattern - 1) - params->ilChessC[1] * pixels[i].conversionPattern;
+        }
+
+        irData = irData - tgcCP;
+        S = irData * compiled->alphaRecip[pixelNumber] * sScale;
+
+        if(S + taTr <= 0)
+        {
+            result[pixelNumber] = NAN;
+            continue;
+        }
+
+        R0 = FastFourthRoot(S + taTr, 2);
+        To = FastFourthRoot(S / (compiled->roughBase + compiled->ksTo[1] * R0) + taTr, 2) - 273.15f;
+        range = (To >= compiled->ct[1]) + (To >= compiled->ct[2]) + (To >= compiled->ct[3]);
+        To = FastFourthRoot(S / (compiled->alphaCorrR[range] * (1 + compiled->ksTo[range] * (To - compiled->ct[range]))) + taTr, 2) - 273.15f;
+
+        result[pixelNumber] = To;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Integer-only variant of MLX90640_CalculateToCompiled for cores without an
+// FPU. Only the per-frame constants are computed in float; the per-pixel path
+// uses 32/64-bit integer multiplies, one 32-bit divide per To stage and an
+// integer fourth root. S is carried in K^4, temperatures in Q16 Kelvin.
+// Against MLX90640_CalculateTo the result stays within 0.005 degC from -40 to
+// 300 degC in both measurement modes (tests/mlx90640_custom).
+void MLX90640_CalculateToFixed(uint16_t *frameData, const paramsMLX90640 *params, const fixedMLX90640 *fixed, float emissivity, float tr, float *result)
+{
+    float vdd;
+    float ta;
+    float ta4;
+    float tr4;
+    float gain;
+    float irDataCP[2];
+    float dTa;
+    float dVdd;
+    float sScale;
+    int sExp;
+    uint8_t mode;
+    uint16_t subPage;
+    const pixelMLX90640 *pixels;
+    uint16_t pixelNumber;
+    int64_t taTr;
+    int64_t gainQ24;
+    int32_t ktaQ;
+    int32_t kvQ;
+    int32_t tgcCPQ8;
+    int32_t sScaleQ16;
+    int sShift;
+    int32_t irDataQ8;
+    int32_t kta;
+    int32_t kv;
+    int64_t S;
+    int32_t ToQ16;
+    int32_t denomQ24;
+    int8_t range;
+
+    subPage = frameData[833];
+    vdd = MLX90640_GetVdd(frameData, params);
+    ta = MLX90640_GetTa(frameData, params);
+
+    ta4 = (ta + 273.15f);
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    tr4 = (tr + 273.15f);
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
+    taTr = llroundf(tr4 - (tr4-ta4)/emissivity);
+
+    dTa = ta - 25;
+    dVdd = vdd - 3.3f;
+
+//------------------------- Per-frame Q constants ------------------------------
+
+    gain = (float)params->gainEE / (int16_t)frameData[778];
+    gainQ24 = llroundf(gain * 16777216.0f);
+    ktaQ = lroundf(ldexpf(dTa, 24 - params->ktaScale));
+    kvQ = lroundf(ldexpf(dVdd, 24 - params->kvScale));
+
+    mode = (frameData[832] & MLX90640_CTRL_MEAS_MODE_MASK) >> 5;
+
+    irDataCP[0] = (int16_t)frameData[776] * gain;
+    irDataCP[1] = (int16_t)frameData[808] * gain;
+
+    irDataCP[0] = irDataCP[0] - params->cpOffset[0] * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    if( mode ==  params->calibrationModeEE)
+    {
+        irDataCP[1] = irDataCP[1] - params->cpOffset[1] * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    }
+    else
+    {
+      irDataCP[1] = irDataCP[1] - (params->cpOffset[1] + params->ilChessC[0]) * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    }
+    tgcCPQ8 = lroundf(params->tgc * irDataCP[subPage] * 256.0f);
+
+    // S = irDataQ8 * alpha[i] * sScale, with sScale split into a Q16 mantissa and a shift
+    sScale = 1.0f / (emissivity * (1 + params->KsTa * dTa) * (float)SCALEALPHA * ldexpf(256.0f, params->alphaScale));
+    sScaleQ16 = lroundf(ldexpf(frexpf(sScale, &sExp), 16));
+    sShift = 16 - sExp;
+
+//------------------------- To calculation -------------------------------------
+
+    pixels = MLX90640_GetSubPagePixels(mode, subPage);
+    for( int i = 0; i < MLX90640_SUBPAGE_PIXEL_NUM; i++)
+    {
+        pixelNumber = pixels[i].pixel;
+
+        irDataQ8 = (int32_t)(((int16_t)frameData[pixelNumber] * gainQ24) >> 16);
+
+        kta = (1 << 24) + (int32_t)((int64_t)params->kta[pixelNumber] * ktaQ);
+        kv = (1 << 24) + (int32_t)((int64_t)params->kv[pixelNumber] * kvQ);
+        irDataQ8 = irDataQ8 - (int32_t)(((((int64_t)params->offset[pixelNumber] * kta) >> 16) * kv) >> 24);
+
+        if(mode !=  params->calibrationModeEE)
+        {
+          irDataQ8 = irDataQ8 + fixed->ilChessC2Q8 * (2 * pixels[i].ilPattern - 1) - fixed->ilChessC1Q8 * pixels[i].conversionPattern;
+        }
+
+        irDataQ8 = irDataQ8 - tgcCPQ8;
+
+        S = (int64_t)irDataQ8 * params->alpha[pixelNumber] * sScaleQ16;
+        S = sShift >= 0 ? S >> sShift : S * ((int64_t)1 << -sShift);
+
+        ToQ16 = FourthRootQ16(S + taTr);
+        if(ToQ16 >= 0)
+        {
+            denomQ24 = fixed->roughBaseQ24 + (int32_t)(((int64_t)fixed->ksToQ30[1] * ToQ16) >> 22);
+            ToQ16 = FourthRootQ16(DivideQ24(S, denomQ24) + taTr);
+        }
+        if(ToQ16 < 0)
+        {
+            result[pixelNumber] = NAN;
+            continue;
+        }
+        ToQ16 = ToQ16 - 17901158;   // 273.15 in Q16
+
+        if(ToQ16 < fixed->ctQ16[1])
+        {
+            range = 0;
+        }
+        else if(ToQ16 < fixed->ctQ16[2])
+        {
+            range = 1;
+        }
+        else if(ToQ16 < fixed->ctQ16[3])
+        {
+            range = 2;
+        }
+        else
+        {
+            range = 3;
+        }
+
+        denomQ24 = (1 << 24) + (int32_t)(((int64_t)fixed->ksToQ30[range] * (ToQ16 - fixed->ctQ16[range])) >> 22);
+        denomQ24 = (int32_t)(((int64_t)fixed->alphaCorrRQ24[range] * denomQ24) >> 24);
+        ToQ16 = FourthRootQ16(DivideQ24(S, denomQ24) + taTr);
+        if(ToQ16 < 0)
+        {
+            result[pixelNumber] = NAN;
+            continue;
+        }
+
+        result[pixelNumber] = (ToQ16 - 17901158) * (1.0f / 65536.0f);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Branch-free variant of MLX90640_CalculateToCompiled over the subpage-grouped
+// tables of MLX90640_CompileVectorParameters, four pixels per step. The range
+// of each lane comes from its rough To and is picked with lane masks; roots
+// are the multiply-only Newton iteration. With fastMath == 0 the
+// result stays within 0.002 degC of MLX90640_CalculateTo from -40 to 300 degC,
+// otherwise it has the error bound of MLX90640_CalculateToFast
+// (tests/mlx90640_custom). Returns -1 without touching result if the tables
+// were compiled for the other measurement mode.
+int MLX90640_CalculateToVector(uint16_t *frameData, const paramsMLX90640 *params, const vectorMLX90640 *vector, float emissivity, float tr, int fastMath, float *result)
+{
+    float vdd;
+    float ta;
+    float ta4;
+    float tr4;
+    float taTr;
+    float gain;
+    float irDataCP[2];
+    float dTa;
+    float dVdd;
+    float sScale;
+    float tgcCP;
+    uint8_t mode;
+    uint16_t subPage;
+    int rootIterations[3];
+    const uint16_t *pixels;
+    const float *offset;
+    const float *kta;
+    const float *kv;
+    const float *alphaRecip;
+    const float *ilChess;
+    alignas(16) float offsetBlock[32];
+    alignas(16) float kvBlock[32];
+    alignas(16) float To[4];
+    vec4f irData;
+    vec4f S;
+    vec4f R0;
+    vec4f ToRough;
+    vec4f alphaCorrR;
+    vec4f ksTo;
+    vec4f ct;
+    vec4i valid;
+    vec4i range;
+
+    subPage = frameData[833];
+    mode = (frameData[832] & MLX90640_CTRL_MEAS_MODE_MASK) >> 5;
+    if(mode != vector->mode)
+    {
+        return -1;
+    }
+
+    vdd = MLX90640_GetVdd(frameData, params);
+    ta = MLX90640_GetTa(frameData, params);
+
+    ta4 = (ta + 273.15f);
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    tr4 = (tr + 273.15f);
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
+    taTr = tr4 - (tr4-ta4)/emissivity;
+
+    dTa = ta - 25;
+    dVdd = vdd - 3.3f;
+
+//------------------------- Per-frame reciprocals ------------------------------
+
+    gain = (float)params->gainEE / (int16_t)frameData[778];
+    sScale = 1.0f / (emissivity * (1 + params->KsTa * dTa));
+
+    irDataCP[0] = (int16_t)frameData[776] * gain;
+    irDataCP[1] = (int16_t)frameData[808] * gain;
+
+    irDataCP[0] = irDataCP[0] - params->cpOffset[0] * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    if( mode ==  params->calibrationModeEE)
+    {
+        irDataCP[1] = irDataCP[1] - params->cpOffset[1] * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    }
+    else
+    {
+      irDataCP[1] = irDataCP[1] - (params->cpOffset[1] + params->ilChessC[0]) * (1 + params->cpKta * dTa) * (1 + params->cpKv * dVdd);
+    }
+    tgcCP = params->tgc * irDataCP[subPage];
+
+    // Newton steps for R0, the rough To and the final To
+    rootIterations[0] = 2;
+    rootIterations[1] = fastMath ? 2 : 3;
+    rootIterations[2] = fastMath ? 2 : 3;
+
+//------------------------- To calculation -------------------------------------
+
+    pixels = vector->pixel[subPage];
+    offset = vector->offset[subPage];
+    kta = vector->kta[subPage];
+    kv = vector->kv[subPage];
+    alphaRecip = vector->alphaRecip[subPage];
+    ilChess = vector->ilChess[subPage];
+
+    for(int block = 0; block < MLX90640_SUBPAGE_PIXEL_NUM; block += 32)
+    {
+        // offset * (1 + kta * dTa) * (1 + kv * dVdd) for the whole block
+        VecScaleAddOne(kta + block, dTa, offsetBlock, 32);
+        VecScaleAddOne(kv + block, dVdd, kvBlock, 32);
+        VecMul(offsetBlock, kvBlock, offsetBlock, 32);
+        VecMul(offsetBlock, offset + block, offsetBlock, 32);
+
+        for(int lane = 0; lane < 32; lane += 4)
+        {
+            int i = block + lane;
+
+            irData = (vec4f){(float)(int16_t)frameData[pixels[i]], (float)(int16_t)frameData[pixels[i + 1]],
+                             (float)(int16_t)frameData[pixels[i + 2]], (float)(int16_t)frameData[pixels[i + 3]]};
+            irData = irData * gain - Vec4Load(offsetBlock + lane) + Vec4Load(ilChess + i) - tgcCP;
+            S = irData * Vec4Load(alphaRecip + i) * sScale;
+
+            valid = (S + taTr) > 0;
+            R0 = Vec4FourthRoot(Vec4Select(valid, S + taTr, Vec4Splat(1.0f)), rootIterations[0]);
+            ToRough = Vec4FourthRoot(S / (vector->roughBase + vector->ksTo[1] * R0) + taTr, rootIterations[1]) - 273.15f;
+            range = -((ToRough >= vector->ct[1]) + (ToRough >= vector->ct[2]) + (ToRough >= vector->ct[3]));
+
+            alphaCorrR = Vec4Select(range == 0, Vec4Splat(vector->alphaCorrR[0]), Vec4Splat(vector->alphaCorrR[1]));
+            alphaCorrR = Vec4Select(range >= 2, Vec4Splat(vector->alphaCorrR[2]), alphaCorrR);
+            alphaCorrR = Vec4Select(range == 3, Vec4Splat(vector->alphaCorrR[3]), alphaCorrR);
+            ksTo = Vec4Select(range == 0, Vec4Splat(vector->ksTo[0]), Vec4Splat(vector->ksTo[1]));
+            ksTo = Vec4Select(range >= 2, Vec4Splat(vector->ksTo[2]), ksTo);
+            ksTo = Vec4Select(range == 3, Vec4Splat(vector->ksTo[3]), ksTo);
+            ct = Vec4Select(range == 0, Vec4Splat(vector->ct[0]), Vec4Splat(vector->ct[1]));
+            ct = Vec4Select(range >= 2, Vec4Splat(vector->ct[2]), ct);
+            ct = Vec4Select(range == 3, Vec4Splat(vector->ct[3]), ct);
+
+            irData = S / (alphaCorrR * (1 + ksTo * (ToRough - ct))) + taTr;
+            valid = valid & (irData > 0);
+
+            Vec4Store(To, Vec4Select(valid, Vec4FourthRoot(irData, rootIterations[2]) - 273.15f, Vec4Splat(NAN)));
+            result[pixels[i]] = To[0];
+            result[pixels[i + 1]] = To[1];
+            result[pixels[i + 2]] = To[2];
+            result[pixels[i + 3]] = To[3];
         }
     }
+
+    return MLX90640_NO_ERROR;
 }
 
 //------------------------------------------------------------------------------
@@ -534,9 +1238,9 @@ void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params, float
     float irData;
     float alphaCompensated;
     uint8_t mode;
+    const pixelMLX90640 *pixels;
+    uint16_t pixelNumber;
     int8_t ilPattern;
-    int8_t chessPattern;
-    int8_t pattern;
     int8_t conversionPattern;
     float image;
     uint16_t subPage;
@@ -573,42 +1277,31 @@ void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params, float
       irDataCP[1] = irDataCP[1] - (params->cpOffset[1] + params->ilChessC[0]) * (1 + params->cpKta * (ta - 25)) * (1 + params->cpKv * (vdd - 3.3));
     }
 
-    for( int pixelNumber = 0; pixelNumber < 768; pixelNumber++)
+    pixels = MLX90640_GetSubPagePixels(mode, subPage);
+    for( int i = 0; i < MLX90640_SUBPAGE_PIXEL_NUM; i++)
     {
-        ilPattern = pixelNumber / 32 - (pixelNumber / 64) * 2; 
-        chessPattern = ilPattern ^ (pixelNumber - (pixelNumber/2)*2); 
-        conversionPattern = ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 + (pixelNumber + 1) / 4 - pixelNumber / 4) * (1 - 2 * ilPattern);
+        pixelNumber = pixels[i].pixel;
+        ilPattern = pixels[i].ilPattern;
+        conversionPattern = pixels[i].conversionPattern;
+
+        irData = (int16_t)frameData[pixelNumber] * gain;
         
-        if(mode == 0)
-        {
-          pattern = ilPattern; 
-        }
-        else 
+        kta = params->kta[pixelNumber]/ktaScale;
+        kv = params->kv[pixelNumber]/kvScale;
+        irData = irData - params->offset[pixelNumber]*(1 + kta*(ta - 25))*(1 + kv*(vdd - 3.3));
+
+        if(mode !=  params->calibrationModeEE)
         {
-          pattern = chessPattern; 
+          irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) - params->ilChessC[1] * conversionPattern; 
         }
         
-        if(pattern == frameData[833])
-        {    
-            irData = (int16_t)frameData[pixelNumber] * gain;
-            
-            kta = params->kta[pixelNumber]/ktaScale;
-            kv = params->kv[pixelNumber]/kvScale;
-            irData = irData - params->offset[pixelNumber]*(1 + kta*(ta - 25))*(1 + kv*(vdd - 3.3));
-
-            if(mode !=  params->calibrationModeEE)
-            {
-              irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) - params->ilChessC[1] * conversionPattern; 
-            }
-            
-            irData = irData - params->tgc * irDataCP[subPage];
-                        
-            alphaCompensated = params->alpha[pixelNumber];
-            
-            image = irData*alphaCompensated;
-            
-            result[pixelNumber] = image;
-        }
+        irData = irData - params->tgc * irDataCP[subPage];
+                    
+        alphaCompensated = params->alpha[pixelNumber];
+        
+        image = irData*alphaCompensated;
+        
+        result[pixelNumber] = image;
     }
 }
 
@@ -657,6 +1350,13 @@ int MLX90640_GetSubPageNumber(uint16_t *frameData)
 
 }    
 
+//------------------------------------------------------------------------------
+
+const pixelMLX90640 *MLX90640_GetSubPagePixels(uint8_t mode, uint16_t subPage)
+{
+    return subPagePixels.list[mode != 0][subPage & 1];
+}
+
 //------------------------------------------------------------------------------
 void MLX90640_BadPixelsCorrection(uint16_t *pixels, float *to, int mode, paramsMLX90640 *params)
 {   
@@ -769,7 +1469,7 @@ static void ExtractVDDParameters(uint16_t *eeData, paramsMLX90640 *mlx90640)
     kVdd = MLX90640_MS_BYTE(eeData[51]);
 
     vdd25 = MLX90640_LS_BYTE(eeData[51]);
-    vdd25 = ((vdd25 - 256) << 5) - 8192;
+    vdd25 = (vdd25 - 256) * 32 - 8192;
     
     mlx90640->kVdd = 32 * kVdd;
     mlx90640->vdd25 = vdd25; 
@@ -934,7 +1634,7 @@ static void ExtractAlphaParameters(uint16_t *eeData, paramsMLX90640 *mlx90640)
                 alphaTemp[p] = alphaTemp[p] - 64;
             }
             alphaTemp[p] = alphaTemp[p]*(1 << accRemScale);
-            alphaTemp[p] = (alphaRef + (accRow[i] << accRowScale) + (accColumn[j] << accColumnScale) + alphaTemp[p]);
+            alphaTemp[p] = (alphaRef + accRow[i] * (1 << accRowScale) + accColumn[j] * (1 << accColumnScale) + alphaTemp[p]);
             alphaTemp[p] = alphaTemp[p] / POW2(alphaScale);
             alphaTemp[p] = alphaTemp[p] - mlx90640->tgc * (mlx90640->cpAlpha[0] + mlx90640->cpAlpha[1])/2;
             alphaTemp[p] = SCALEALPHA/alphaTemp[p];
@@ -1031,7 +1731,7 @@ static void ExtractOffsetParameters(uint16_t *eeData, paramsMLX90640 *mlx90640)
                 mlx90640->offset[p] = mlx90640->offset[p] - 64;
             }
             mlx90640->offset[p] = mlx90640->offset[p]*(1 << occRemScale);
-            mlx90640->offset[p] = (offsetRef + (occRow[i] << occRowScale) + (occColumn[j] << occColumnScale) + mlx90640->offset[p]);
+            mlx90640->offset[p] = (offsetRef + occRow[i] * (1 << occRowScale) + occColumn[j] * (1 << occColumnScale) + mlx90640->offset[p]);
         }
     }
 }
@@ -1455,3 +2155,98 @@ static int IsPixelBad(uint16_t pixel,paramsMLX90640 *params)
 }     
 
 //------------------------------------------------------------------------------
+
+static uint32_t ISqrt64(uint64_t x)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while(bit > x)
+    {
+        bit >>= 2;
+    }
+
+    while(bit != 0)
+    {
+        if(x >= root + bit)
+        {
+            x = x - (root + bit);
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)root;
+}
+
+//------------------------------------------------------------------------------
+
+// x^(1/4) in Q16 for x in K^4, or -1 when x is negative
+static int32_t FourthRootQ16(int64_t x)
+{
+    uint32_t root2;
+
+    if(x < 0)
+    {
+        return -1;
+    }
+    if(x > (1LL << 47))
+    {
+        x = 1LL << 47;      // (4096 K)^4, far outside the sensor range
+    }
+
+    root2 = ISqrt64((uint64_t)x << 16);
+    return (int32_t)ISqrt64((uint64_t)root2 << 24);
+}
+
+//------------------------------------------------------------------------------
+
+// value / (denomQ24 / 2^24) through a 32-bit reciprocal; a denominator outside
+// the physical range yields a negative sentinel so the root reports NaN
+static int64_t DivideQ24(int64_t value, int32_t denomQ24)
+{
+    uint32_t denomQ16;
+    uint32_t recipQ16;
+
+    if(denomQ24 < (1 << 20))
+    {
+        return INT64_MIN / 2;
+    }
+
+    denomQ16 = (uint32_t)denomQ24 >> 8;
+    recipQ16 = 0xFFFFFFFFu / denomQ16;
+
+    return (value * recipQ16) >> 16;
+}
+
+//------------------------------------------------------------------------------
+
+// x^(1/4) for x > 0. The seed for x^(-1/4) comes from the float bit pattern
+// (max relative error 9.4%), each Newton step y = y * (5 - x * y^4) / 4 squares
+// the error: 0.73% after one step, 4.5e-5 after two.
+static float FastFourthRoot(float x, int iterations)
+{
+    union
+    {
+        float f;
+        int32_t i;
+    } seed;
+    float y;
+
+    seed.f = x;
+    seed.i = 0x4F584000 - (seed.i >> 2);
+    y = seed.f;
+
+    for(int iteration = 0; iteration < iterations; iteration++)
+    {
+        y = y * (1.25f - 0.25f * x * (y * y) * (y * y));
+    }
+
+    return x * y * y * y;
+}
+
+//------------------------------------------------------------------------------
@@ -107,21 +107,91 @@ typedef struct
         uint16_t brokenPixels[5];
         uint16_t outlierPixels[5];  
     } paramsMLX90640;
-    
+
+// Per-pixel calibration derived once from paramsMLX90640 so the To kernel does
+// not rescale kta/kv/alpha or call pow() on every frame.
+typedef struct
+    {
+        float kta[768];         // kta[i] / 2^ktaScale
+        float kv[768];          // kv[i] / 2^kvScale
+        float offset[768];
+        float alphaRecip[768];  // 1 / (SCALEALPHA * 2^alphaScale / alpha[i])
+        float alphaCorrR[4];
+        float ksTo[4];
+        float ct[4];
+        float roughBase;        // 1 - ksTo[1] * 273.15
+    } compiledMLX90640;
+
+// Sensor-wide constants for the integer To kernel. The per-pixel tables in
+// paramsMLX90640 are already Q-format integers (offset Q0, kta Q(ktaScale),
+// kv Q(kvScale), alpha Q(alphaScale)) and are read from there directly, so
+// the fixed-point path needs no extra per-pixel RAM.
+typedef struct
+    {
+        int32_t alphaCorrRQ24[4];
+        int32_t ksToQ30[4];
+        int32_t ctQ16[4];
+        int32_t roughBaseQ24;   // 1 - ksTo[1] * 273.15
+        int32_t ilChessC1Q8;
+        int32_t ilChessC2Q8;
+    } fixedMLX90640;
+
+// One live pixel of a subpage, with the interleave row pattern and the
+// conversion sign the chess/interleave correction needs.
+typedef struct
+    {
+        uint16_t pixel;
+        int8_t ilPattern;
+        int8_t conversionPattern;
+    } pixelMLX90640;
+
+#define MLX90640_SUBPAGE_PIXEL_NUM 384
+
+// Structure-of-arrays float calibration for the vectorised To kernel, for one
+// measurement mode. Each table is grouped by subpage and ordered like
+// MLX90640_GetSubPagePixels, so the kernel walks all of them linearly and
+// four pixels at a time.
+typedef struct
+    {
+        alignas(16) float offset[2][MLX90640_SUBPAGE_PIXEL_NUM];
+        alignas(16) float kta[2][MLX90640_SUBPAGE_PIXEL_NUM];
+        alignas(16) float kv[2][MLX90640_SUBPAGE_PIXEL_NUM];
+        alignas(16) float alphaRecip[2][MLX90640_SUBPAGE_PIXEL_NUM];
+        alignas(16) float ilChess[2][MLX90640_SUBPAGE_PIXEL_NUM];  // 0 when mode matches calibrationModeEE
+        uint16_t pixel[2][MLX90640_SUBPAGE_PIXEL_NUM];
+        float alphaCorrR[4];
+        float ksTo[4];
+        float ct[4];
+        float roughBase;
+        uint8_t mode;
+    } vectorMLX90640;
+
     int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData);
     int MLX90640_SynchFrame(uint8_t slaveAddr);
     int MLX90640_TriggerMeasurement(uint8_t slaveAddr);
     int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData);
+    int MLX90640_GetDataReady(uint8_t slaveAddr, uint16_t *statusRegister);
+    int MLX90640_ReadPixelData(uint8_t slaveAddr, uint16_t statusRegister, uint16_t *frameData);
+    int MLX90640_ReadSubPagePixelData(uint8_t slaveAddr, uint16_t statusRegister, uint16_t *frameData);
+    int MLX90640_ReadAuxData(uint8_t slaveAddr, uint16_t *frameData);
     int MLX90640_ExtractParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
+    void MLX90640_CompileParameters(const paramsMLX90640 *params, compiledMLX90640 *compiled);
+    void MLX90640_CompileFixedParameters(const paramsMLX90640 *params, fixedMLX90640 *fixed);
+    void MLX90640_CompileVectorParameters(const paramsMLX90640 *params, uint8_t mode, vectorMLX90640 *vector);
     float MLX90640_GetVdd(uint16_t *frameData, const paramsMLX90640 *params);
     float MLX90640_GetTa(uint16_t *frameData, const paramsMLX90640 *params);
     void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params, float *result);
     void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params, float emissivity, float tr, float *result);
+    void MLX90640_CalculateToCompiled(uint16_t *frameData, const paramsMLX90640 *params, const compiledMLX90640 *compiled, float emissivity, float tr, float *result);
+    void MLX90640_CalculateToFast(uint16_t *frameData, const paramsMLX90640 *params, const compiledMLX90640 *compiled, float emissivity, float tr, float *result);
+    void MLX90640_CalculateToFixed(uint16_t *frameData, const paramsMLX90640 *params, const fixedMLX90640 *fixed, float emissivity, float tr, float *result);
+    int MLX90640_CalculateToVector(uint16_t *frameData, const paramsMLX90640 *params, const vectorMLX90640 *vector, float emissivity, float tr, int fastMath, float *result);
     int MLX90640_SetResolution(uint8_t slaveAddr, uint8_t resolution);
     int MLX90640_GetCurResolution(uint8_t slaveAddr);
     int MLX90640_SetRefreshRate(uint8_t slaveAddr, uint8_t refreshRate);   
     int MLX90640_GetRefreshRate(uint8_t slaveAddr);  
     int MLX90640_GetSubPageNumber(uint16_t *frameData);
+    const pixelMLX90640 *MLX90640_GetSubPagePixels(uint8_t mode, uint16_t subPage);
     int MLX90640_GetCurMode(uint8_t slaveAddr); 
     int MLX90640_SetInterleavedMode(uint8_t slaveAddr);
     int MLX90640_SetChessMode(uint8_t slaveAddr);
@@ -1,51 +1,198 @@
 #include "MLX90640_I2C_Driver.h"
+#include "esphome/core/hal.h"
 #include "esphome/core/log.h"
-#include <vector>
+#include <algorithm>
+
+#if defined(USE_MLX90640_I2C_CLOCK) && __has_include(<driver/i2c_master.h>)
+#include <esp_idf_version.h>
+// i2c_master_get_bus_handle arrived in ESP-IDF 5.3
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#include <driver/i2c_master.h>
+#define MLX90640_I2C_CLOCK
+#endif
+#endif
 
-static esphome::i2c::I2CDevice *global_mlx_device = nullptr;
 static const char *const TAG = "mlx90640_driver";
 
-void MLX90640_SetDevice(esphome::i2c::I2CDevice *dev) {
-  global_mlx_device = dev;
+#ifdef MLX90640_I2C_CLOCK
+static const int CLOCK_TIMEOUT_MS = 100;
+#endif
+
+// Everything the driver keeps for one sensor. The Melexis API passes slaveAddr
+// through to MLX90640_I2CRead/MLX90640_I2CWrite untouched, so it carries the
+// handle from MLX90640_SetDevice rather than the bus address; two sensors can
+// then share an address on different buses.
+struct MLX90640_I2CContext {
+  esphome::i2c::I2CDevice *device;
+  MLX90640_I2CStats stats;
+#ifdef MLX90640_I2C_CLOCK
+  // The ESP-IDF master driver clocks each transfer at its device's
+  // scl_speed_hz, so a private handle for the sensor runs at its own rate
+  // while the other devices on the bus keep theirs. Without one, transfers go
+  // through the ESPHome device at the bus frequency.
+  int clock_port; // of the sensor's bus, -1 until MLX90640_I2CSetBusPort
+  i2c_master_bus_handle_t clock_bus;
+  i2c_master_dev_handle_t clock_device;
+  int clock_khz;
+#endif
+};
+
+static MLX90640_I2CContext contexts[MLX90640_MAX_DEVICES] = {};
+
+static MLX90640_I2CContext *get_context(uint8_t handle) {
+  if (handle >= MLX90640_MAX_DEVICES || contexts[handle].device == nullptr)
+    return nullptr;
+  return &contexts[handle];
+}
+
+int MLX90640_SetDevice(esphome::i2c::I2CDevice *dev) {
+  for (uint8_t handle = 0; handle < MLX90640_MAX_DEVICES; handle++) {
+    if (contexts[handle].device == dev)
+      return handle;
+  }
+  for (uint8_t handle = 0; handle < MLX90640_MAX_DEVICES; handle++) {
+    if (contexts[handle].device == nullptr) {
+      contexts[handle] = {};
+      contexts[handle].device = dev;
+#ifdef MLX90640_I2C_CLOCK
+      contexts[handle].clock_port = -1;
+#endif
+      return handle;
+    }
+  }
+  return -1;
+}
+
+static bool bus_write_read(MLX90640_I2CContext *ctx, const uint8_t *cmd,
+                           size_t cmdLength, uint8_t *buf, size_t length) {
+#ifdef MLX90640_I2C_CLOCK
+  if (ctx->clock_device != nullptr)
+    return i2c_master_transmit_receive(ctx->clock_device, cmd, cmdLength, buf,
+                                       length, CLOCK_TIMEOUT_MS) == ESP_OK;
+#endif
+  return ctx->device->write_read(cmd, cmdLength, buf, length) ==
+         esphome::i2c::ERROR_OK;
+}
+
+static bool bus_write(MLX90640_I2CContext *ctx, const uint8_t *cmd,
+                      size_t cmdLength) {
+#ifdef MLX90640_I2C_CLOCK
+  if (ctx->clock_device != nullptr)
+    return i2c_master_transmit(ctx->clock_device, cmd, cmdLength,
+                               CLOCK_TIMEOUT_MS) == ESP_OK;
+#endif
+  return ctx->device->write(cmd, cmdLength) == esphome::i2c::ERROR_OK;
+}
+
+static void record_transfer(MLX90640_I2CContext *ctx, uint32_t bytes,
+                            uint32_t start) {
+  uint32_t elapsed = esphome::micros() - start;
+  ctx->stats.bytes = bytes;
+  ctx->stats.micros = elapsed;
+  ctx->stats.total_bytes += bytes;
+  ctx->stats.total_micros += elapsed;
 }
 
 // Read a number of words from startAddress. Store into Data array.
+// Reads straight into data in chunks of at most I2C_BUFFER_LENGTH bytes and
+// byte-swaps in place, so nothing is allocated.
 // Returns 0 if successful, -1 if error
-int MLX90640_I2CRead(uint8_t _deviceAddress, unsigned int startAddress,
+int MLX90640_I2CRead(uint8_t slaveAddr, unsigned int startAddress,
                      unsigned int nWordsRead, uint16_t *data) {
-  if (global_mlx_device == nullptr)
+  MLX90640_I2CContext *ctx = get_context(slaveAddr);
+  if (ctx == nullptr)
     return -1;
 
-  uint8_t cmd[2];
-  cmd[0] = startAddress >> 8;
-  cmd[1] = startAddress & 0xFF;
+  uint32_t start = esphome::micros();
+  uint8_t *bytes = reinterpret_cast<uint8_t *>(data);
+  const unsigned int chunkWords = I2C_BUFFER_LENGTH / 2;
 
-  uint16_t bytesRemaining = nWordsRead * 2;
-  // Use vector to avoid VLA
-  std::vector<uint8_t> buf(bytesRemaining);
+  for (unsigned int offset = 0; offset < nWordsRead; offset += chunkWords) {
+    unsigned int words = std::min(chunkWords, nWordsRead - offset);
+    unsigned int address = startAddress + offset;
+    uint8_t cmd[2];
+    cmd[0] = address >> 8;
+    cmd[1] = address & 0xFF;
 
-  if (global_mlx_device->write_read(cmd, 2, buf.data(), bytesRemaining) !=
-      esphome::i2c::ERROR_OK) {
-    ESP_LOGW(TAG, "I2C fail: write_read address 0x%04X", startAddress);
-    return -1;
+    if (!bus_write_read(ctx, cmd, 2, bytes + offset * 2, words * 2)) {
+      ESP_LOGW(TAG, "I2C fail: write_read address 0x%04X", address);
+      record_transfer(ctx, offset * 2, start);
+      return -1;
+    }
   }
 
-  for (int i = 0; i < nWordsRead; i++) {
-    data[i] = (buf[i * 2] << 8) | buf[i * 2 + 1];
+  // The sensor sends MSB first; swap each word over its own two bytes
+  for (unsigned int i = 0; i < nWordsRead; i++) {
+    data[i] = (bytes[i * 2] << 8) | bytes[i * 2 + 1];
   }
 
+  record_transfer(ctx, nWordsRead * 2, start);
   return 0; // Success
 }
 
-// Set I2C Freq, in kHz
-void MLX90640_I2CFreqSet(int freq) {
+// ESP-IDF port of the bus the sensor is registered on. MLX90640_I2CFreqSet
+// adds its private clock device to that bus's master handle.
+void MLX90640_I2CSetBusPort(uint8_t slaveAddr, int port) {
+#ifdef MLX90640_I2C_CLOCK
+  MLX90640_I2CContext *ctx = get_context(slaveAddr);
+  if (ctx == nullptr || port == ctx->clock_port)
+    return;
+  MLX90640_I2CFreqSet(slaveAddr, 0);
+  ctx->clock_port = port;
+  ctx->clock_bus = nullptr;
+#else
+  (void) slaveAddr;
+  (void) port;
+#endif
+}
+
+// Set I2C Freq, in kHz. 0 goes back to the ESPHome bus frequency.
+void MLX90640_I2CFreqSet(uint8_t slaveAddr, int freq) {
+#ifdef MLX90640_I2C_CLOCK
+  MLX90640_I2CContext *ctx = get_context(slaveAddr);
+  if (ctx == nullptr || freq == ctx->clock_khz)
+    return;
+  if (ctx->clock_device != nullptr) {
+    i2c_master_bus_rm_device(ctx->clock_device);
+    ctx->clock_device = nullptr;
+  }
+  ctx->clock_khz = 0;
+  if (freq <= 0)
+    return;
+  if (ctx->clock_bus == nullptr &&
+      (ctx->clock_port < 0 ||
+       i2c_master_get_bus_handle((i2c_port_num_t)ctx->clock_port,
+                                 &ctx->clock_bus) != ESP_OK)) {
+    ESP_LOGW(TAG, "No I2C master bus handle, keeping the bus frequency");
+    ctx->clock_bus = nullptr;
+    return;
+  }
+
+  i2c_device_config_t config = {};
+  config.dev_addr_length = I2C_ADDR_BIT_LEN_7;
+  config.device_address = ctx->device->get_i2c_address();
+  config.scl_speed_hz = freq * 1000;
+  if (i2c_master_bus_add_device(ctx->clock_bus, &config, &ctx->clock_device) !=
+      ESP_OK) {
+    ESP_LOGW(TAG, "Failed to add %d kHz device, keeping the bus frequency",
+             freq);
+    ctx->clock_device = nullptr;
+    return;
+  }
+  ctx->clock_khz = freq;
+  ESP_LOGD(TAG, "I2C clock %d kHz", freq);
+#else
   // Managed by ESPHome I2C component
+  (void) slaveAddr;
+  (void) freq;
+#endif
 }
 
 // Write two bytes to a two byte address
-int MLX90640_I2CWrite(uint8_t _deviceAddress, unsigned int writeAddress,
+int MLX90640_I2CWrite(uint8_t slaveAddr, unsigned int writeAddress,
                       uint16_t data) {
-  if (global_mlx_device == nullptr)
+  MLX90640_I2CContext *ctx = get_context(slaveAddr);
+  if (ctx == nullptr)
     return -1;
 
   uint8_t cmd[4];
@@ -54,9 +201,18 @@ int MLX90640_I2CWrite(uint8_t _deviceAddress, unsigned int writeAddress,
   cmd[2] = data >> 8;
   cmd[3] = data & 0xFF;
 
-  if (global_mlx_device->write(cmd, 4) != esphome::i2c::ERROR_OK) {
+  uint32_t start = esphome::micros();
+  if (!bus_write(ctx, cmd, 4)) {
+    record_transfer(ctx, 0, start);
     return -1;
   }
 
+  record_transfer(ctx, 4, start);
   return 0; // Success
 }
+
+const MLX90640_I2CStats *MLX90640_I2CGetStats(uint8_t slaveAddr) {
+  static const MLX90640_I2CStats none = {};
+  MLX90640_I2CContext *ctx = get_context(slaveAddr);
+  return ctx != nullptr ? &ctx->stats : &none;
+}
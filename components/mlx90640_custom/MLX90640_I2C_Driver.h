@@ -36,20 +36,47 @@
 // Teensy
 
 #elif ARDUINO_ARCH_ESP32
-// ESP32 based platforms
+// ESP32 based platforms, Wire buffers 128 bytes per transfer
+#define I2C_BUFFER_LENGTH 128
+
+#elif defined(USE_ESP_IDF)
+// The ESP-IDF driver has no transfer buffer; a whole EEPROM dump fits
+#define I2C_BUFFER_LENGTH 1664
 
 #else
 
 // The catch-all default is 32
 #define I2C_BUFFER_LENGTH 32
 
+#endif
+
+#ifndef I2C_BUFFER_LENGTH
+#define I2C_BUFFER_LENGTH 32
 #endif
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
-void MLX90640_SetDevice(esphome::i2c::I2CDevice *dev);
+// Bus traffic of the last MLX90640_I2CRead/MLX90640_I2CWrite call, and the
+// running totals since boot
+struct MLX90640_I2CStats {
+  uint32_t bytes;
+  uint32_t micros;
+  uint32_t total_bytes;
+  uint32_t total_micros;
+};
+
+// Sensors the driver can address at once
+#ifndef MLX90640_MAX_DEVICES
+#define MLX90640_MAX_DEVICES 4
+#endif
+
+// Registers a sensor and returns the handle to pass as slaveAddr to the API,
+// or -1 when MLX90640_MAX_DEVICES are already registered
+int MLX90640_SetDevice(esphome::i2c::I2CDevice *dev);
 int MLX90640_I2CRead(uint8_t slaveAddr, unsigned int startAddress,
                      unsigned int nWordsRead, uint16_t *data);
 int MLX90640_I2CWrite(uint8_t slaveAddr, unsigned int writeAddress,
                       uint16_t data);
-void MLX90640_I2CFreqSet(int freq);
+void MLX90640_I2CSetBusPort(uint8_t slaveAddr, int port);
+void MLX90640_I2CFreqSet(uint8_t slaveAddr, int freq);
+const MLX90640_I2CStats *MLX90640_I2CGetStats(uint8_t slaveAddr);
 #endif
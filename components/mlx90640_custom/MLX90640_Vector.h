@@ -0,0 +1,89 @@
+#ifndef _MLX90640_VECTOR_H_
+#define _MLX90640_VECTOR_H_
+
+#include <stdint.h>
+
+// Small 4-lane float abstraction for the vectorised To kernel.
+//
+// Lane ops use GCC vector extensions: SSE/NEON on a development host, plain
+// scalar FPU code on Xtensa and RISC-V. There is no ESP32-S3 PIE backend: the
+// PIE's 128-bit registers only do 8/16/32-bit integer arithmetic, and the
+// kernel needs float lanes with divides; integer lanes would mean rescaling
+// into Q formats, which is MLX90640_CalculateToFixed's job. On the S3 the
+// elementwise block ops are instead routed through esp-dsp (when the project
+// pulls it in), whose f32 loops are scheduled for the core's scalar FPU.
+// All pointers passed to these helpers must be 16-byte aligned.
+
+#if defined(USE_ESP32_VARIANT_ESP32S3) && __has_include(<esp_dsp.h>)
+#include <esp_dsp.h>
+#define MLX90640_VECTOR_ESP_DSP
+#endif
+
+typedef float vec4f __attribute__((vector_size(16)));
+typedef int32_t vec4i __attribute__((vector_size(16)));
+
+static inline vec4f Vec4Load(const float *p)
+{
+    return *(const vec4f *)p;
+}
+
+static inline void Vec4Store(float *p, vec4f v)
+{
+    *(vec4f *)p = v;
+}
+
+static inline vec4f Vec4Splat(float x)
+{
+    vec4f v = {x, x, x, x};
+    return v;
+}
+
+// mask lanes are all-ones (take a) or zero (take b), as produced by comparisons
+static inline vec4f Vec4Select(vec4i mask, vec4f a, vec4f b)
+{
+    return (vec4f)(((vec4i)a & mask) | ((vec4i)b & ~mask));
+}
+
+// x^(1/4) per lane, see FastFourthRoot in MLX90640_API.cpp for the error bounds
+static inline vec4f Vec4FourthRoot(vec4f x, int iterations)
+{
+    vec4f y = (vec4f)(0x4F584000 - ((vec4i)x >> 2));
+
+    for(int iteration = 0; iteration < iterations; iteration++)
+    {
+        y = y * (1.25f - 0.25f * x * (y * y) * (y * y));
+    }
+
+    return x * y * y * y;
+}
+
+//------------------------------------------------------------------------------
+// Block ops over n floats, n a multiple of 4
+
+static inline void VecMul(const float *a, const float *b, float *out, int n)
+{
+#ifdef MLX90640_VECTOR_ESP_DSP
+    dsps_mul_f32(a, b, out, n, 1, 1, 1);
+#else
+    for(int i = 0; i < n; i += 4)
+    {
+        Vec4Store(out + i, Vec4Load(a + i) * Vec4Load(b + i));
+    }
+#endif
+}
+
+// out = a * c + 1
+static inline void VecScaleAddOne(const float *a, float c, float *out, int n)
+{
+#ifdef MLX90640_VECTOR_ESP_DSP
+    dsps_mulc_f32(a, out, n, c, 1, 1);
+    dsps_addc_f32(out, out, n, 1.0f, 1, 1);
+#else
+    for(int i = 0; i < n; i += 4)
+    {
+        Vec4Store(out + i, Vec4Load(a + i) * c + 1.0f);
+    }
+#endif
+}
+
+#endif
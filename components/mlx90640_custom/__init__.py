@@ -1,12 +1,63 @@
 print("DEBUG: LOADING MLX90640_CUSTOM __INIT__.PY")
 import esphome.codegen as cg
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 from esphome.components import i2c, sensor
-from esphome.const import CONF_ID
+from esphome.const import (
+    CONF_I2C_ID,
+    CONF_ID,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    KEY_CORE,
+    KEY_FRAMEWORK_VERSION,
+)
 from esphome.core import CORE
 from . import ns
 DEPENDENCIES = ["i2c", "sensor"]
 AUTO_LOAD = ["i2c", "sensor"]
+# One block per sensor, up to MLX90640_MAX_DEVICES
+MULTI_CONF = True
+
+# ThermalPalette in palettes.h
+PALETTES = {
+    "rainbow": 0,
+    "ironbow": 1,
+    "grayscale": 2,
+    "white_hot": 3,
+}
+
+def _validate_region(config):
+    if "mask" in config:
+        if "width" in config or "height" in config:
+            raise cv.Invalid("Give a region either width/height or a mask")
+        width = max((len(row) for row in config["mask"]), default=0)
+        height = len(config["mask"])
+    else:
+        if "width" not in config or "height" not in config:
+            raise cv.Invalid("A region needs width and height, or a mask")
+        width, height = config["width"], config["height"]
+    if config["x"] + width > 32 or config["y"] + height > 24:
+        raise cv.Invalid("Region extends past the 32x24 frame")
+    return config
+
+
+REGION_SCHEMA = cv.All(cv.Schema({
+    # Top-left pixel, column 0-31 and row 0-23
+    cv.Optional("x", default=0): cv.int_range(min=0, max=31),
+    cv.Optional("y", default=0): cv.int_range(min=0, max=23),
+    cv.Optional("width"): cv.int_range(min=1, max=32),
+    cv.Optional("height"): cv.int_range(min=1, max=24),
+    # Rows of pixels from (x, y); "." leaves a pixel out, e.g. "..##.."
+    cv.Optional("mask"): cv.All(cv.ensure_list(cv.string_strict), cv.Length(min=1)),
+    cv.Optional("min_temperature"): sensor.sensor_schema(
+        unit_of_measurement="°C", accuracy_decimals=1
+    ),
+    cv.Optional("max_temperature"): sensor.sensor_schema(
+        unit_of_measurement="°C", accuracy_decimals=1
+    ),
+    cv.Optional("mean_temperature"): sensor.sensor_schema(
+        unit_of_measurement="°C", accuracy_decimals=1
+    ),
+}), _validate_region)
 
 CONFIG_SCHEMA = cv.Schema({
     cv.GenerateID(): cv.declare_id(ns.MLX90640Component),
@@ -27,11 +78,176 @@ CONFIG_SCHEMA = cv.Schema({
     cv.Optional("median_temperature"): sensor.sensor_schema(
         unit_of_measurement="°C", accuracy_decimals=1
     ),
+    cv.Optional("percentiles"): cv.ensure_list(
+        sensor.sensor_schema(
+            unit_of_measurement="°C", accuracy_decimals=1
+        ).extend({
+            cv.Required("percentile"): cv.float_range(min=0.0, max=100.0),
+        })
+    ),
+    # Hot spots: pixels at or above threshold, grouped into connected blobs
+    cv.Optional("blobs"): cv.Schema({
+        cv.Required("threshold"): cv.temperature,
+        # Smaller blobs are ignored as noise
+        cv.Optional("min_area", default=2): cv.int_range(min=1, max=768),
+        cv.Optional("count"): sensor.sensor_schema(accuracy_decimals=0),
+        cv.Optional("largest_area"): sensor.sensor_schema(
+            unit_of_measurement="px", accuracy_decimals=0
+        ),
+        # Of the largest blob, in pixels from the top-left corner
+        cv.Optional("centroid_x"): sensor.sensor_schema(
+            unit_of_measurement="px", accuracy_decimals=1
+        ),
+        cv.Optional("centroid_y"): sensor.sensor_schema(
+            unit_of_measurement="px", accuracy_decimals=1
+        ),
+        # Hottest pixel of the largest blob
+        cv.Optional("peak_temperature"): sensor.sensor_schema(
+            unit_of_measurement="°C", accuracy_decimals=1
+        ),
+    }),
+    # Zones of the frame with their own sensors, at most 16
+    cv.Optional("regions"): cv.All(
+        cv.ensure_list(REGION_SCHEMA), cv.Length(max=16)
+    ),
     cv.Optional("mintemp", default=15.0): cv.float_,
     cv.Optional("maxtemp", default=40.0): cv.float_,
-    cv.Optional("refresh_rate"): cv.int_,
+    # Image range follows the scene instead of mintemp/maxtemp
+    cv.Optional("auto_range"): cv.Schema({
+        # equalize spreads the palette over the histogram; clip stretches
+        # linearly between the clip percentiles
+        cv.Optional("mode", default="equalize"): cv.one_of(
+            "equalize", "clip", lower=True
+        ),
+        # Pixels ignored at each end of the range
+        cv.Optional("clip", default="1%"): cv.All(
+            cv.percentage, cv.Range(max=0.45)
+        ),
+        # Time constant of range changes
+        cv.Optional(
+            "smoothing", default="1s"
+        ): cv.positive_time_period_milliseconds,
+    }),
+    # Colour map of the camera image and the BMP
+    cv.Optional("palette", default="rainbow"): cv.enum(PALETTES, lower=True),
+    # Subpage rate in Hz, rounded up to the next the sensor supports
+    cv.Optional("refresh_rate"): cv.int_range(min=1, max=64),
+    # ADC resolution in bits; with a governor, the highest it may pick
+    cv.Optional("resolution"): cv.int_range(min=16, max=19),
+    # Picks refresh rate, resolution (up to resolution:) and update interval
+    # from these targets and backs off when frames overrun
+    cv.Optional("governor"): cv.Schema({
+        cv.Optional("max_latency"): cv.positive_time_period_milliseconds,
+        cv.Optional("max_cpu"): cv.percentage,
+        cv.Optional("refresh_rate"): sensor.sensor_schema(
+            unit_of_measurement="Hz", accuracy_decimals=1,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("resolution"): sensor.sensor_schema(
+            unit_of_measurement="bit", accuracy_decimals=0,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("frame_time"): sensor.sensor_schema(
+            unit_of_measurement="ms", accuracy_decimals=1,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("cpu_usage"): sensor.sensor_schema(
+            unit_of_measurement="%", accuracy_decimals=1,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+    }),
+    # Integer To kernel; defaults to on for ESP32 variants without an FPU
+    cv.Optional("fixed_point"): cv.boolean,
+    # Approximate fourth roots (max 0.03 C error) for high refresh rates
+    cv.Optional("fast_math", default=False): cv.boolean,
+    # 4-lane To kernel over structure-of-arrays tables. Without SIMD float
+    # lanes it compiles to scalar code, so it only pays off where the lanes
+    # map to hardware; the ESP32 variants have none
+    cv.Optional("vectorize", default=False): cv.boolean,
+    # Interleaved measurement mode; reads only the 12 rows each subpage updates
+    cv.Optional("interleaved", default=False): cv.boolean,
+    # I2C clock for the EEPROM dump and for frame reads (ESP-IDF 5.3 or
+    # later); the other devices on the bus keep the bus frequency
+    cv.Optional("setup_frequency"): cv.All(
+        cv.only_with_esp_idf, cv.frequency, cv.Range(min=10e3, max=1e6)
+    ),
+    cv.Optional("stream_frequency"): cv.All(
+        cv.only_with_esp_idf, cv.frequency, cv.Range(min=10e3, max=1e6)
+    ),
+    # URL path prefix of this sensor's image; must differ between sensors
+    cv.Optional("web_path", default="/thermal"): cv.All(
+        cv.string_strict, cv.Length(min=2)
+    ),
+    # multipart/x-mixed-replace stream of BMP frames at <web_path>/stream
+    cv.Optional("stream", default={}): cv.Schema({
+        cv.Optional("max_clients", default=2): cv.int_range(min=0, max=8),
+        # 0 sends every frame the sensor produces
+        cv.Optional("max_fps", default=0): cv.float_range(min=0.0),
+    }),
+    # Acquire and convert frames in a FreeRTOS task on the other core
+    cv.Optional("acquisition_task", default=False): cv.boolean,
+    # Read on demand: the sensor keeps measuring, but frames are only read and
+    # converted when a poll, camera or HTTP request asks, and are served up to
+    # frame_cache old without reading again
+    cv.Optional("on_demand", default=False): cv.boolean,
+    cv.Optional(
+        "frame_cache", default="1s"
+    ): cv.positive_time_period_milliseconds,
 }).extend(cv.polling_component_schema("60s")).extend(i2c.i2c_device_schema(0x33))
 
+# i2c_master_get_bus_handle, which the per-device clocks need
+I2C_CLOCK_MIN_IDF_VERSION = cv.Version(5, 3, 0)
+
+
+def _final_validate(config):
+    # All sensors share one HTTP server, which keeps the first handler
+    # registered for a URI
+    sensors = fv.full_config.get().get("mlx90640_custom", [])
+    if isinstance(sensors, dict):
+        sensors = [sensors]
+    if sum(s["web_path"] == config["web_path"] for s in sensors) > 1:
+        raise cv.Invalid(
+            f"web_path {config['web_path']} is used by another mlx90640_custom "
+            "sensor, give each sensor its own",
+            path=["web_path"],
+        )
+
+    version = CORE.data[KEY_CORE][KEY_FRAMEWORK_VERSION]
+    # The clock is set on the ESP-IDF handle of the sensor's own bus, so that
+    # must be one of the chip's, not a multiplexer channel
+    buses = [bus[CONF_ID].id for bus in fv.full_config.get().get("i2c", [])]
+    for key in ("setup_frequency", "stream_frequency"):
+        if key not in config:
+            continue
+        if version < I2C_CLOCK_MIN_IDF_VERSION:
+            raise cv.Invalid(
+                f"{key} needs ESP-IDF {I2C_CLOCK_MIN_IDF_VERSION} or later, "
+                f"the framework is {version}",
+                path=[key],
+            )
+        if config[CONF_I2C_ID].id not in buses:
+            raise cv.Invalid(
+                f"{key} needs the sensor on an i2c: bus directly, not behind "
+                "a multiplexer",
+                path=[key],
+            )
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
+# RISC-V ESP32 variants have no floating point unit
+NO_FPU_VARIANTS = ["ESP32C2", "ESP32C3", "ESP32C6", "ESP32H2"]
+
+
+def _has_no_fpu():
+    if not CORE.is_esp32:
+        return False
+    from esphome.components.esp32 import get_esp32_variant
+
+    return get_esp32_variant() in NO_FPU_VARIANTS
+
+
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
@@ -41,6 +257,9 @@ async def to_code(config):
     cg.add_define("USE_MLX90640_WEB_SERVER")
     cg.add_global(cg.RawStatement('#include <esp_http_server.h>'))
 
+    cg.add(var.set_web_path(config["web_path"]))
+    cg.add(var.set_stream_max_clients(config["stream"]["max_clients"]))
+    cg.add(var.set_stream_max_fps(config["stream"]["max_fps"]))
     cg.add(var.set_emissivity(config[ns.CONF_EMISSIVITY]))
     
     if "min_temperature" in config:
@@ -59,8 +278,79 @@ async def to_code(config):
         sens = await sensor.new_sensor(config["median_temperature"])
         cg.add(var.set_median_temperature_sensor(sens))
 
+    for conf in config.get("percentiles", []):
+        sens = await sensor.new_sensor(conf)
+        cg.add(var.add_percentile_sensor(conf["percentile"], sens))
+
+    for conf in config.get("regions", []):
+        sensors = []
+        for key in ("min_temperature", "max_temperature", "mean_temperature"):
+            sensors.append(
+                await sensor.new_sensor(conf[key]) if key in conf else cg.nullptr
+            )
+        if "mask" in conf:
+            cg.add(var.add_region_mask(conf["x"], conf["y"], conf["mask"], *sensors))
+        else:
+            cg.add(var.add_region(
+                conf["x"], conf["y"], conf["width"], conf["height"], *sensors
+            ))
+
+    if "blobs" in config:
+        blobs = config["blobs"]
+        cg.add(var.set_blobs(blobs["threshold"], blobs["min_area"]))
+        for key in (
+            "count", "largest_area", "centroid_x", "centroid_y", "peak_temperature"
+        ):
+            if key in blobs:
+                sens = await sensor.new_sensor(blobs[key])
+                cg.add(getattr(var, f"set_blob_{key}_sensor")(sens))
+
+    if "refresh_rate" in config:
+        cg.add(var.set_refresh_rate(config["refresh_rate"]))
+    if "resolution" in config:
+        cg.add(var.set_resolution(config["resolution"]))
+    if "governor" in config:
+        gov = config["governor"]
+        if "max_latency" in gov:
+            cg.add(var.set_max_latency(gov["max_latency"].total_milliseconds))
+        if "max_cpu" in gov:
+            cg.add(var.set_max_cpu(gov["max_cpu"]))
+        for key in ("refresh_rate", "resolution", "frame_time", "cpu_usage"):
+            if key in gov:
+                sens = await sensor.new_sensor(gov[key])
+                cg.add(getattr(var, f"set_governor_{key}_sensor")(sens))
+
     cg.add(var.set_min_image_temp(config["mintemp"]))
     cg.add(var.set_max_image_temp(config["maxtemp"]))
+    cg.add(var.set_palette(config["palette"]))
+    if "auto_range" in config:
+        auto_range = config["auto_range"]
+        cg.add(var.set_auto_range(
+            auto_range["mode"] == "equalize",
+            auto_range["clip"],
+            auto_range["smoothing"].total_milliseconds,
+        ))
+
+    fixed_point = config.get("fixed_point")
+    if fixed_point is None:
+        fixed_point = _has_no_fpu()
+    cg.add(var.set_fixed_point(fixed_point))
+    cg.add(var.set_fast_math(config["fast_math"]))
+
+    cg.add(var.set_vectorize(config["vectorize"]))
+    cg.add(var.set_interleaved(config["interleaved"]))
+    cg.add(var.set_acquisition_task(config["acquisition_task"]))
+    cg.add(var.set_on_demand(config["on_demand"]))
+    cg.add(var.set_frame_cache(config["frame_cache"].total_milliseconds))
+
+    if "setup_frequency" in config or "stream_frequency" in config:
+        # Per-device clocks need the i2c_master driver, which the ESPHome
+        # i2c bus must also be using; the schema allows them on ESP-IDF only
+        cg.add_define("USE_MLX90640_I2C_CLOCK")
+        if "setup_frequency" in config:
+            cg.add(var.set_setup_frequency(int(config["setup_frequency"] / 1000)))
+        if "stream_frequency" in config:
+            cg.add(var.set_stream_frequency(int(config["stream_frequency"] / 1000)))
 
 
 
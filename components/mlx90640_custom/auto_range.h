@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace mlx90640 {
+
+// Automatic gain for the rendered image. Each frame's temperatures go into a
+// fixed histogram during the statistics pass; finish() then derives either a
+// percentile-clipped linear range or a histogram-equalised mapping, smoothed
+// over time so the colours do not flicker, and index() maps a temperature to
+// a palette index during the render pass. Fixed memory, no extra passes.
+class AutoRange {
+public:
+  // Histogram over the sensor's full range in half-degree bins; index()
+  // interpolates within a bin, so equalisation stays smooth
+  static constexpr float MIN_TEMP = -40.0f;
+  static constexpr float MAX_TEMP = 300.0f;
+  static constexpr float BIN_WIDTH = 0.5f;
+  static constexpr int BINS = (int)((MAX_TEMP - MIN_TEMP) / BIN_WIDTH);
+  // Narrowest range the image is stretched to, linearly or equalised, so a
+  // uniform scene shows as uniform instead of as amplified noise
+  static constexpr float MIN_SPAN = 2.0f;
+
+  // Equalise the histogram instead of stretching linearly
+  void set_equalize(bool equalize) { this->equalize_ = equalize; }
+  // Share of pixels clipped at each end, 0-0.5
+  void set_clip(float fraction) { this->clip_ = fraction; }
+  // Time constant of the range and mapping, 0 to follow each frame
+  void set_smoothing(uint32_t ms) { this->smoothing_ms_ = ms; }
+
+  // Start of a frame's statistics pass
+  void reset() {
+    memset(this->counts_, 0, sizeof(this->counts_));
+    this->total_ = 0;
+  }
+  void add(float temp) {
+    if (!std::isfinite(temp))
+      return;
+    int bin = (int)((temp - MIN_TEMP) * (1.0f / BIN_WIDTH));
+    bin = bin < 0 ? 0 : (bin >= BINS ? BINS - 1 : bin);
+    this->counts_[bin]++;
+    this->total_++;
+  }
+  // End of the statistics pass; now_ms is the frame's timestamp
+  void finish(uint32_t now_ms) {
+    if (this->total_ == 0)
+      return;
+    float alpha = 1.0f;
+    if (this->started_ && this->smoothing_ms_ > 0) {
+      float dt = (float)(now_ms - this->last_ms_);
+      alpha = dt / (this->smoothing_ms_ + dt);
+    }
+    this->started_ = true;
+    this->last_ms_ = now_ms;
+
+    // Clipped ends, interpolated within their bins
+    const uint32_t cut = (uint32_t)(this->total_ * this->clip_);
+    const uint32_t kept = std::max<uint32_t>(this->total_ - 2 * cut, 1);
+    float low = NAN, high = NAN;
+    uint32_t below = 0;
+    for (int bin = 0; bin < BINS; bin++) {
+      uint32_t count = this->counts_[bin];
+      if (std::isnan(low) && below + count > cut)
+        low = edge_temp_(bin + (float)(cut - below) / count);
+      if (below + count >= this->total_ - cut) {
+        high = edge_temp_(bin + (float)(this->total_ - cut - below) / count);
+        break;
+      }
+      below += count;
+    }
+    // Below MIN_SPAN equalisation would stretch noise just the same, so its
+    // map is blended toward the linear one over the widened range, fully
+    // linear for a uniform scene
+    const float equalised = std::min((high - low) / MIN_SPAN, 1.0f);
+    if (high - low < MIN_SPAN) {
+      float mid = (low + high) / 2.0f;
+      low = mid - MIN_SPAN / 2.0f;
+      high = mid + MIN_SPAN / 2.0f;
+    }
+    this->low_ += alpha * (low - this->low_);
+    this->high_ += alpha * (high - this->high_);
+    this->scale_ = 255.0f / (this->high_ - this->low_);
+    this->offset_ = -this->low_ * this->scale_;
+
+    if (this->equalize_) {
+      // Cumulative share of the kept pixels below each bin edge, in Q8
+      below = 0;
+      for (int edge = 0; edge <= BINS; edge++) {
+        float share = ((float)below - cut) / kept;
+        float linear = (edge_temp_(edge) - low) / (high - low);
+        share = equalised * share + (1.0f - equalised) * linear;
+        share = share < 0.0f ? 0.0f : (share > 1.0f ? 1.0f : share);
+        float target = share * (255.0f * 256.0f);
+        this->cdf_[edge] =
+            (uint16_t)(this->cdf_[edge] + alpha * (target - this->cdf_[edge]));
+        if (edge < BINS)
+          below += this->counts_[edge];
+      }
+    }
+  }
+
+  uint8_t index(float temp) const {
+    if (!this->equalize_) {
+      float index = temp * this->scale_ + this->offset_;
+      return index <= 0.0f ? 0 : (index >= 255.0f ? 255 : (uint8_t)index);
+    }
+    float pos = (temp - MIN_TEMP) * (1.0f / BIN_WIDTH);
+    if (pos <= 0.0f)
+      return this->cdf_[0] >> 8;
+    if (pos >= BINS)
+      return this->cdf_[BINS] >> 8;
+    int edge = (int)pos;
+    float f = pos - edge;
+    return (uint16_t)(this->cdf_[edge] +
+                      f * (this->cdf_[edge + 1] - this->cdf_[edge])) >>
+           8;
+  }
+
+  // Smoothed range the image currently spans
+  float low() const { return this->low_; }
+  float high() const { return this->high_; }
+
+protected:
+  static float edge_temp_(float bin) { return MIN_TEMP + bin * BIN_WIDTH; }
+
+  bool equalize_{false};
+  float clip_{0.01f};
+  uint32_t smoothing_ms_{1000};
+
+  uint16_t counts_[BINS]{};
+  uint16_t total_{0};
+  uint16_t cdf_[BINS + 1]{}; // smoothed equalisation map, Q8 palette index
+  float low_{0.0f};
+  float high_{0.0f};
+  float scale_{0.0f};
+  float offset_{0.0f};
+  bool started_{false};
+  uint32_t last_ms_{0};
+};
+
+} // namespace mlx90640
+} // namespace esphome
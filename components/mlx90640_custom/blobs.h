@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace mlx90640 {
+
+// Hot spots: pixels at or above a threshold, grouped into 8-connected blobs
+// with a union-find over the 32x24 frame. Two raster passes and fixed
+// tables, so the time per frame is bounded whatever the scene.
+class BlobDetector {
+public:
+  static const int WIDTH = 32;
+  static const int HEIGHT = 24;
+  static const int PIXELS = WIDTH * HEIGHT;
+  // Most separate 8-connected blobs the frame can hold: every other pixel
+  // of every other row
+  static const int MAX_BLOBS = (WIDTH + 1) / 2 * ((HEIGHT + 1) / 2);
+
+  struct Result {
+    uint16_t count{0};        // blobs of at least min_area pixels
+    uint16_t largest_area{0}; // pixels
+    float centroid_x{NAN};    // of the largest blob, in pixels from the left
+    float centroid_y{NAN};    // and from the top
+    float peak{NAN};          // hottest pixel of the largest blob
+  };
+
+  void set_threshold(float threshold) { this->threshold_ = threshold; }
+  void set_min_area(uint16_t pixels) { this->min_area_ = pixels; }
+
+  const Result &detect(const float *to) {
+    // Pass 1: link each hot pixel to its hot neighbours above and to the left
+    for (int y = 0; y < HEIGHT; y++) {
+      for (int x = 0; x < WIDTH; x++) {
+        int i = y * WIDTH + x;
+        if (!(to[i] >= this->threshold_)) { // NaN is never hot
+          this->parent_[i] = NONE;
+          continue;
+        }
+        this->parent_[i] = i;
+        if (x > 0)
+          this->join_(i, i - 1);
+        if (y > 0) {
+          if (x > 0)
+            this->join_(i, i - WIDTH - 1);
+          this->join_(i, i - WIDTH);
+          if (x < WIDTH - 1)
+            this->join_(i, i - WIDTH + 1);
+        }
+      }
+    }
+
+    // Pass 2: number the roots and accumulate each blob
+    uint16_t blobs = 0;
+    for (int i = 0; i < PIXELS; i++) {
+      if (this->parent_[i] == NONE)
+        continue;
+      uint16_t root = this->find_(i);
+      if (root == i) {
+        this->label_[i] = blobs;
+        this->blobs_[blobs] = Blob{0, 0, 0, -INFINITY};
+        blobs++;
+      }
+      Blob &blob = this->blobs_[this->label_[root]];
+      blob.area++;
+      blob.sum_x += i % WIDTH;
+      blob.sum_y += i / WIDTH;
+      blob.peak = std::fmax(blob.peak, to[i]);
+    }
+
+    this->result_ = Result();
+    const Blob *largest = nullptr;
+    for (uint16_t b = 0; b < blobs; b++) {
+      const Blob &blob = this->blobs_[b];
+      if (blob.area < this->min_area_)
+        continue;
+      this->result_.count++;
+      if (largest == nullptr || blob.area > largest->area)
+        largest = &blob;
+    }
+    if (largest != nullptr) {
+      this->result_.largest_area = largest->area;
+      this->result_.centroid_x = (float)largest->sum_x / largest->area;
+      this->result_.centroid_y = (float)largest->sum_y / largest->area;
+      this->result_.peak = largest->peak;
+    }
+    return this->result_;
+  }
+
+protected:
+  static const uint16_t NONE = 0xFFFF;
+
+  struct Blob {
+    uint16_t area;
+    uint16_t sum_x; // at most 768 * 31
+    uint16_t sum_y;
+    float peak;
+  };
+
+  // Path halving; trees stay shallow without ranks
+  uint16_t find_(uint16_t i) {
+    while (this->parent_[i] != i) {
+      this->parent_[i] = this->parent_[this->parent_[i]];
+      i = this->parent_[i];
+    }
+    return i;
+  }
+  // The lower index becomes the root, so pass 2 meets every root before the
+  // rest of its blob
+  void join_(uint16_t a, uint16_t b) {
+    if (this->parent_[b] == NONE)
+      return;
+    a = this->find_(a);
+    b = this->find_(b);
+    if (a < b)
+      this->parent_[b] = a;
+    else if (b < a)
+      this->parent_[a] = b;
+  }
+
+  float threshold_{NAN};
+  uint16_t min_area_{1};
+  uint16_t parent_[PIXELS];
+  uint8_t label_[PIXELS];  // blob number, valid at roots
+  Blob blobs_[MAX_BLOBS];
+  Result result_;
+};
+
+} // namespace mlx90640
+} // namespace esphome
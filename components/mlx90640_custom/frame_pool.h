@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace esphome {
+namespace mlx90640 {
+
+// Small pool of reference-counted, immutable buffers with one writer and any
+// number of readers on any task. The writer fills a free slot from acquire()
+// and makes it the latest with publish(); readers take a Ref to the latest
+// slot and read it in place. A slot is only reused once the last Ref to it is
+// gone and it is no longer the latest, so nothing is copied and no one locks.
+template<typename T, uint8_t N> class FramePool {
+public:
+  class Ref {
+  public:
+    Ref() = default;
+    Ref(const Ref &) = delete;
+    Ref &operator=(const Ref &) = delete;
+    Ref(Ref &&other) : pool_(other.pool_), slot_(other.slot_) {
+      other.pool_ = nullptr;
+    }
+    Ref &operator=(Ref &&other) {
+      if (this != &other) {
+        this->reset();
+        this->pool_ = other.pool_;
+        this->slot_ = other.slot_;
+        other.pool_ = nullptr;
+      }
+      return *this;
+    }
+    ~Ref() { this->reset(); }
+
+    void reset() {
+      if (this->pool_ != nullptr)
+        this->pool_->release_(this->slot_);
+      this->pool_ = nullptr;
+    }
+    explicit operator bool() const { return this->pool_ != nullptr; }
+    const T &operator*() const { return this->pool_->slots_[this->slot_]; }
+    const T *operator->() const { return &this->pool_->slots_[this->slot_]; }
+
+  protected:
+    friend class FramePool;
+    Ref(FramePool *pool, uint8_t slot) : pool_(pool), slot_(slot) {}
+
+    FramePool *pool_{nullptr};
+    uint8_t slot_{0};
+  };
+
+  // Writer side. Returns nullptr when readers hold every other slot.
+  T *acquire() {
+    for (uint8_t slot = 0; slot < N; slot++) {
+      uint32_t expected = 0;
+      if (this->refs_[slot].compare_exchange_strong(expected, 1)) {
+        this->writing_ = slot;
+        return &this->slots_[slot];
+      }
+    }
+    return nullptr;
+  }
+  // Makes the acquired slot the latest; the writer's reference passes to it
+  void publish() {
+    int8_t previous = this->latest_.exchange(this->writing_);
+    if (previous >= 0)
+      this->release_(previous);
+  }
+
+  // Reader side, any task. Empty until the first publish().
+  Ref latest() {
+    for (;;) {
+      int8_t slot = this->latest_.load();
+      if (slot < 0)
+        return Ref();
+      this->refs_[slot].fetch_add(1);
+      // The slot may have been replaced and recycled in between
+      if (this->latest_.load() == slot)
+        return Ref(this, slot);
+      this->release_(slot);
+    }
+  }
+
+protected:
+  void release_(uint8_t slot) { this->refs_[slot].fetch_sub(1); }
+
+  T slots_[N]{};
+  std::atomic<uint32_t> refs_[N]{};
+  std::atomic<int8_t> latest_{-1};
+  uint8_t writing_{0};
+};
+
+} // namespace mlx90640
+} // namespace esphome
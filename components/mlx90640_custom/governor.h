@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace esphome {
+namespace mlx90640 {
+
+// What the governor settled on, carried with each frame so the main loop can
+// publish and apply it without touching the acquisition side
+struct GovernorDecision {
+  uint8_t rate_code{0};    // MLX90640 refresh-rate code, 0 (0.5 Hz) to 7 (64 Hz)
+  uint8_t resolution{0};   // ADC resolution code, 0 (16 bit) to 3 (19 bit)
+  uint32_t interval_ms{0}; // update interval
+  uint32_t cost_us{0};     // smoothed I2C + conversion time per frame
+  float cpu_usage{0.0f};   // share of time spent on frames, 0-1
+};
+
+// Picks the refresh-rate code, ADC resolution and update interval from a
+// latency and CPU budget, and backs the rate off when frames overrun. Policy
+// only: the component feeds it the measured cost of each frame and applies
+// the result to the sensor and the poller.
+class AcquisitionGovernor {
+public:
+  static constexpr uint8_t MAX_RATE_CODE = 7;
+  // Frames without an overrun before a backed-off rate is tried again
+  static constexpr uint16_t BACKOFF_HOLD_FRAMES = 32;
+
+  // Sensor period of one subpage; a frame is two
+  static uint32_t subpage_period_ms(uint8_t rate_code) {
+    return 2000 >> rate_code;
+  }
+  // Shorter integration at high rates leaves the low bits in the noise, so
+  // trade them for ADC headroom there and keep 19 bits for slow scenes
+  static uint8_t resolution_for(uint8_t rate_code) {
+    if (rate_code <= 1)
+      return 3;
+    if (rate_code <= 4)
+      return 2;
+    return rate_code == 5 ? 1 : 0;
+  }
+
+  // 0 leaves the configured refresh rate and update interval alone
+  void set_max_latency(uint32_t ms) { this->max_latency_ms_ = ms; }
+  // 0-1, 0 for no limit
+  void set_max_cpu(float fraction) { this->max_cpu_ = fraction; }
+  // Highest resolution code it may pick, from an explicit resolution: option
+  void set_max_resolution(uint8_t code) { this->max_resolution_ = code; }
+  uint8_t max_resolution() const { return this->max_resolution_; }
+  // Continuous: every sensor frame is converted (acquisition task).
+  // Otherwise one frame is acquired per update interval.
+  void set_continuous(bool continuous) { this->continuous_ = continuous; }
+
+  // Initial choice from the configuration, before any frame was measured
+  void start(uint8_t rate_code, uint32_t interval_ms) {
+    this->configured_code_ = rate_code;
+    this->configured_interval_ms_ = interval_ms;
+    this->decide_();
+  }
+
+  // Feeds one completed frame: the time spent reading and converting it, and
+  // how many subpages were read to assemble it (2 unless one was missed).
+  // Returns true when the refresh rate or resolution changed.
+  bool frame_done(uint32_t busy_us, uint8_t subpage_reads) {
+    this->decision_.cost_us =
+        this->decision_.cost_us == 0
+            ? busy_us
+            : (this->decision_.cost_us * 3 + busy_us) / 4;
+
+    uint8_t code = this->decision_.rate_code;
+    bool overrun =
+        subpage_reads > 2 || busy_us / 2 > subpage_period_ms(code) * 1000;
+    if (overrun && code > 0) {
+      this->ceiling_ = code - 1;
+      this->hold_ = BACKOFF_HOLD_FRAMES;
+    } else if (this->hold_ > 0 && --this->hold_ == 0 &&
+               this->ceiling_ < MAX_RATE_CODE) {
+      this->ceiling_++;
+      if (this->ceiling_ < MAX_RATE_CODE)
+        this->hold_ = BACKOFF_HOLD_FRAMES;
+    }
+
+    this->decide_();
+    return this->decision_.rate_code != code;
+  }
+
+  const GovernorDecision &decision() const { return this->decision_; }
+  // The rate is held below what the targets ask for after an overrun
+  bool backed_off() const { return this->backed_off_; }
+
+protected:
+  void decide_() {
+    GovernorDecision &d = this->decision_;
+    uint32_t cost_ms = (d.cost_us + 999) / 1000;
+
+    // Slowest rate whose worst case, a wait for the subpage in progress plus
+    // both of ours, still fits the latency budget
+    uint8_t code = this->configured_code_;
+    if (this->max_latency_ms_ > 0) {
+      code = 0;
+      while (code < MAX_RATE_CODE &&
+             3 * subpage_period_ms(code) + cost_ms > this->max_latency_ms_)
+        code++;
+    }
+    this->backed_off_ = code > this->ceiling_;
+    code = std::min(code, this->ceiling_);
+    if (this->continuous_ && this->max_cpu_ > 0.0f && d.cost_us > 0) {
+      // Every frame is converted, so the rate itself sets the load
+      while (code > 0 && d.cost_us * 500.0f / subpage_period_ms(code) >
+                             this->max_cpu_ * 1e6f)
+        code--;
+    }
+
+    uint32_t interval = this->max_latency_ms_ > 0
+                            ? this->max_latency_ms_
+                            : this->configured_interval_ms_;
+    if (!this->continuous_) {
+      // One frame at a time: never start the next before this one can finish,
+      // and space them out to the CPU budget
+      interval = std::max(interval, 3 * subpage_period_ms(code) + cost_ms);
+      if (this->max_cpu_ > 0.0f)
+        interval = std::max(
+            interval, (uint32_t)(d.cost_us / (this->max_cpu_ * 1000.0f)));
+    }
+
+    d.rate_code = code;
+    d.resolution = std::min(resolution_for(code), this->max_resolution_);
+    d.interval_ms = interval;
+    d.cpu_usage = this->continuous_
+                      ? d.cost_us * 0.0005f / subpage_period_ms(code)
+                      : d.cost_us / (interval * 1000.0f);
+  }
+
+  uint32_t max_latency_ms_{0};
+  float max_cpu_{0.0f};
+  bool continuous_{false};
+  uint8_t max_resolution_{3};
+  uint8_t configured_code_{2};
+  uint32_t configured_interval_ms_{0};
+  uint8_t ceiling_{MAX_RATE_CODE};
+  uint16_t hold_{0};
+  bool backed_off_{false};
+  GovernorDecision decision_;
+};
+
+} // namespace mlx90640
+} // namespace esphome
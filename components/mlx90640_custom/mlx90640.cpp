@@ -1,84 +1,266 @@
 #include "mlx90640.h"
+#include "palettes.h"
+#ifdef USE_MLX90640_WEB_SERVER
+#include "thermal_page.h"
+#endif
 #include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 namespace esphome {
 namespace mlx90640 {
 
 static const char *const TAG = "mlx90640";
 
-// Global buffer for web server response (simple non-concurrent solution)
-#ifdef USE_MLX90640_WEB_SERVER
-static std::vector<uint8_t> g_bmp_buffer;
+// EEPROM words 0x2407..0x2409 hold the sensor's unique device ID
+static const uint16_t MLX90640_DEVICE_ID_ADDRESS = 0x2407;
+// EEPROM words 0x2410..0x243F hold the device-level calibration; together with
+// the device ID they key the calibration cache
+static const uint16_t MLX90640_DEVICE_CALIBRATION_ADDRESS = 0x2410;
+static const uint16_t MLX90640_DEVICE_CALIBRATION_NUM = 48;
+// Subpage reads allowed to collect both halves of one frame
+static const uint8_t FRAME_ASSEMBLY_ATTEMPTS = 3;
+// Consecutive failed acquisitions before the sensor is reinitialised
+static const uint8_t ACQUISITION_RECOVERY_FAILURES = 3;
+#ifdef USE_ESP32
+// Acquisition task: data-ready poll period and FreeRTOS parameters
+static const uint32_t ACQUISITION_TASK_POLL_MS = 5;
+static const uint32_t ACQUISITION_TASK_STACK_SIZE = 4096;
+static const UBaseType_t ACQUISITION_TASK_PRIORITY = 2;
 #endif
 
-// Palette from Chill-Division/M5Stack-ESPHome
-static const uint16_t camColors[] = {
-    0x480F, 0x400F, 0x400F, 0x400F, 0x4010, 0x3810, 0x3810, 0x3810, 0x3810,
-    0x3010, 0x3010, 0x3010, 0x2810, 0x2810, 0x2810, 0x2810, 0x2010, 0x2010,
-    0x2010, 0x1810, 0x1810, 0x1811, 0x1811, 0x1011, 0x1011, 0x1011, 0x0811,
-    0x0811, 0x0811, 0x0011, 0x0011, 0x0011, 0x0011, 0x0011, 0x0031, 0x0031,
-    0x0051, 0x0072, 0x0072, 0x0092, 0x00B2, 0x00B2, 0x00D2, 0x00F2, 0x00F2,
-    0x0112, 0x0132, 0x0152, 0x0152, 0x0172, 0x0192, 0x0192, 0x01B2, 0x01D2,
-    0x01F3, 0x01F3, 0x0213, 0x0233, 0x0253, 0x0253, 0x0273, 0x0293, 0x02B3,
-    0x02D3, 0x02D3, 0x02F3, 0x0313, 0x0333, 0x0333, 0x0353, 0x0373, 0x0394,
-    0x03B4, 0x03D4, 0x03D4, 0x03F4, 0x0414, 0x0434, 0x0454, 0x0474, 0x0474,
-    0x0494, 0x04B4, 0x04D4, 0x04F4, 0x0514, 0x0534, 0x0534, 0x0554, 0x0554,
-    0x0574, 0x0574, 0x0573, 0x0573, 0x0573, 0x0572, 0x0572, 0x0572, 0x0571,
-    0x0591, 0x0591, 0x0590, 0x0590, 0x058F, 0x058F, 0x058F, 0x058E, 0x05AE,
-    0x05AE, 0x05AD, 0x05AD, 0x05AD, 0x05AC, 0x05AC, 0x05AB, 0x05CB, 0x05CB,
-    0x05CA, 0x05CA, 0x05CA, 0x05C9, 0x05C9, 0x05C8, 0x05E8, 0x05E8, 0x05E7,
-    0x05E7, 0x05E6, 0x05E6, 0x05E6, 0x05E5, 0x05E5, 0x0604, 0x0604, 0x0604,
-    0x0603, 0x0603, 0x0602, 0x0602, 0x0601, 0x0621, 0x0621, 0x0620, 0x0620,
-    0x0620, 0x0620, 0x0E20, 0x0E20, 0x0E40, 0x1640, 0x1640, 0x1E40, 0x1E40,
-    0x2640, 0x2640, 0x2E40, 0x2E60, 0x3660, 0x3660, 0x3E60, 0x3E60, 0x3E60,
-    0x4660, 0x4660, 0x4E60, 0x4E80, 0x5680, 0x5680, 0x5E80, 0x5E80, 0x6680,
-    0x6680, 0x6E80, 0x6EA0, 0x76A0, 0x76A0, 0x7EA0, 0x7EA0, 0x86A0, 0x86A0,
-    0x8EA0, 0x8EC0, 0x96C0, 0x96C0, 0x9EC0, 0x9EC0, 0xA6C0, 0xAEC0, 0xAEC0,
-    0xB6E0, 0xB6E0, 0xBEE0, 0xBEE0, 0xC6E0, 0xC6E0, 0xCEE0, 0xCEE0, 0xD6E0,
-    0xD700, 0xDF00, 0xDEE0, 0xDEC0, 0xDEA0, 0xDE80, 0xDE80, 0xE660, 0xE640,
-    0xE620, 0xE600, 0xE5E0, 0xE5C0, 0xE5A0, 0xE580, 0xE560, 0xE540, 0xE520,
-    0xE500, 0xE4E0, 0xE4C0, 0xE4A0, 0xE480, 0xE460, 0xEC40, 0xEC20, 0xEC00,
-    0xEBE0, 0xEBC0, 0xEBA0, 0xEB80, 0xEB60, 0xEB40, 0xEB20, 0xEB00, 0xEAE0,
-    0xEAC0, 0xEAA0, 0xEA80, 0xEA60, 0xEA40, 0xF220, 0xF200, 0xF1E0, 0xF1C0,
-    0xF1A0, 0xF180, 0xF160, 0xF140, 0xF100, 0xF0E0, 0xF0C0, 0xF0A0, 0xF080,
-    0xF060, 0xF040, 0xF020, 0xF800,
-};
+static uint32_t eeprom_hash(const uint16_t *ee_data, int count) {
+  // FNV-1a over the EEPROM words
+  uint32_t hash = 2166136261UL;
+  for (int i = 0; i < count; i++) {
+    hash = (hash ^ (ee_data[i] & 0xFF)) * 16777619UL;
+    hash = (hash ^ (ee_data[i] >> 8)) * 16777619UL;
+  }
+  return hash;
+}
+
 
 void MLX90640Component::setup() {
   ESP_LOGCONFIG(TAG, "Setting up MLX90640...");
 
   // Init I2C Driver with this device
-  MLX90640_SetDevice(this);
+  int handle = MLX90640_SetDevice(this);
+  if (handle < 0) {
+    ESP_LOGE(TAG, "More than %d MLX90640 sensors", MLX90640_MAX_DEVICES);
+    this->mark_failed();
+    return;
+  }
+  this->handle_ = handle;
+#ifdef USE_MLX90640_WEB_SERVER
+  this->boot_id_ = random_uint32();
+#endif
+#ifdef USE_MLX90640_I2C_CLOCK
+  // The private clock goes on the bus this sensor is registered on; the
+  // schema only allows it on one of the chip's own buses, not a multiplexer
+  MLX90640_I2CSetBusPort(
+      this->handle_,
+      static_cast<i2c::InternalI2CBus *>(this->bus_)->get_port());
+#endif
+  MLX90640_I2CFreqSet(this->handle_, this->setup_frequency_);
 
-  // Check connection
+  // The device ID selects the calibration cache; reading it also checks the
+  // connection
   int status;
-  uint16_t ee_data[832];
-  status = MLX90640_DumpEE(this->address_, ee_data);
-
+  status = MLX90640_I2CRead(this->handle_, MLX90640_DEVICE_ID_ADDRESS, 3,
+                            this->device_id_);
   if (status != 0) {
-    ESP_LOGE(TAG, "Failed to dump EEPROM data");
+    ESP_LOGE(TAG, "Failed to read device ID");
     this->mark_failed();
     return;
   }
-
-  // Calibration parameters
-  status = MLX90640_ExtractParameters(ee_data, &this->mlx90640_params_);
+  // The cache is only taken if the device-level calibration words match too,
+  // which costs a 48-word read instead of the full 832-word dump
+  uint16_t device_calibration[MLX90640_DEVICE_CALIBRATION_NUM];
+  status = MLX90640_I2CRead(this->handle_, MLX90640_DEVICE_CALIBRATION_ADDRESS,
+                            MLX90640_DEVICE_CALIBRATION_NUM,
+                            device_calibration);
   if (status != 0) {
-    ESP_LOGE(TAG, "Failed to extract parameters");
+    ESP_LOGE(TAG, "Failed to read device calibration");
     this->mark_failed();
     return;
   }
+  this->eeprom_hash_ =
+      eeprom_hash(device_calibration, MLX90640_DEVICE_CALIBRATION_NUM);
+
+  this->calibration_pref_ =
+      global_preferences->make_preference<MLX90640CalibrationCache>(
+          fnv1_hash("mlx90640_calibration") ^
+              fnv1_hash(str_sprintf("%04X%04X%04X", this->device_id_[0],
+                                    this->device_id_[1], this->device_id_[2])),
+          true);
+  if (!this->load_calibration_()) {
+    if (!this->read_calibration_()) {
+      this->mark_failed();
+      return;
+    }
+    this->save_calibration_();
+  }
+  this->compile_calibration_();
 
   // Set refresh rate
+  this->rate_code_ = 1;
+  while (this->rate_code_ < AcquisitionGovernor::MAX_RATE_CODE &&
+         (1 << (this->rate_code_ - 1)) < this->refresh_rate_)
+    this->rate_code_++;
+  const uint8_t configured_code = this->rate_code_;
+  const uint32_t configured_interval = this->get_update_interval();
+  if (this->governor_enabled_) {
+    this->governor_.set_continuous(this->acquisition_task_ && !this->on_demand_);
+    this->governor_.start(configured_code, configured_interval);
+    this->apply_governor_();
+    this->set_update_interval(this->governor_.decision().interval_ms);
+  }
   this->set_refresh_rate_hw_();
+  if (this->interleaved_ &&
+      MLX90640_SetInterleavedMode(this->handle_) != MLX90640_NO_ERROR) {
+    ESP_LOGW(TAG, "Failed to select interleaved mode, reading full frames");
+    this->interleaved_ = false;
+  }
+  MLX90640_I2CFreqSet(this->handle_, this->stream_frequency_);
+
+#ifdef USE_ESP32
+  if (this->on_demand_) {
+    this->image_ready_ = xSemaphoreCreateBinary();
+    if (this->image_ready_ == nullptr)
+      ESP_LOGE(TAG, "Failed to create the image semaphore, requests will not "
+                    "wait for fresh frames");
+  }
+  if (this->acquisition_task_) {
+#if portNUM_PROCESSORS > 1
+    // Opposite core to the main loop
+    BaseType_t core = xPortGetCoreID() == 0 ? 1 : 0;
+#else
+    BaseType_t core = 0;
+#endif
+    if (xTaskCreatePinnedToCore(MLX90640Component::acquisition_task_fn_,
+                                "mlx90640", ACQUISITION_TASK_STACK_SIZE, this,
+                                ACQUISITION_TASK_PRIORITY,
+                                &this->acquisition_task_handle_,
+                                core) != pdPASS) {
+      ESP_LOGE(TAG, "Failed to start acquisition task, using the main loop");
+      this->acquisition_task_handle_ = nullptr;
+      if (this->governor_enabled_) {
+        this->governor_.set_continuous(false);
+        this->governor_.start(configured_code, configured_interval);
+        this->apply_governor_();
+        this->set_update_interval(this->governor_.decision().interval_ms);
+        this->set_refresh_rate_hw_();
+      }
+    }
+  }
+#endif
 
   ESP_LOGCONFIG(TAG, "MLX90640 Setup Complete");
 }
 
+bool MLX90640Component::load_calibration_() {
+  std::unique_ptr<MLX90640CalibrationCache> cache(new MLX90640CalibrationCache);
+  if (!this->calibration_pref_.load(cache.get())) {
+    ESP_LOGD(TAG, "No cached calibration");
+    return false;
+  }
+  if (cache->version != CALIBRATION_CACHE_VERSION ||
+      memcmp(cache->device_id, this->device_id_, sizeof(this->device_id_)) !=
+          0) {
+    ESP_LOGI(TAG, "Cached calibration belongs to another sensor, ignoring");
+    return false;
+  }
+  if (cache->eeprom_hash != this->eeprom_hash_) {
+    ESP_LOGW(TAG, "Cached calibration does not match EEPROM, re-extracting");
+    return false;
+  }
+
+  this->mlx90640_params_ = cache->params;
+  this->calibration_cached_ = true;
+  ESP_LOGD(TAG, "Calibration loaded from flash");
+  return true;
+}
+
+bool MLX90640Component::read_calibration_() {
+  uint16_t ee_data[MLX90640_EEPROM_DUMP_NUM];
+  int status = MLX90640_DumpEE(this->handle_, ee_data);
+  if (status != 0) {
+    ESP_LOGE(TAG, "Failed to dump EEPROM data");
+    return false;
+  }
+
+  // Calibration parameters, taken only once the whole dump checks out so a
+  // bad one leaves the current calibration in place. On the heap like the
+  // cache: several KB, next to the dump already on the stack.
+  std::unique_ptr<paramsMLX90640> params(new paramsMLX90640);
+  status = MLX90640_ExtractParameters(ee_data, params.get());
+  if (status != 0) {
+    ESP_LOGE(TAG, "Failed to extract parameters");
+    return false;
+  }
+  this->mlx90640_params_ = *params;
+  memcpy(this->device_id_, &ee_data[MLX90640_DEVICE_ID_ADDRESS -
+                                    MLX90640_EEPROM_START_ADDRESS],
+         sizeof(this->device_id_));
+  this->eeprom_hash_ = eeprom_hash(&ee_data[MLX90640_DEVICE_CALIBRATION_ADDRESS -
+                                            MLX90640_EEPROM_START_ADDRESS],
+                                   MLX90640_DEVICE_CALIBRATION_NUM);
+  this->calibration_cached_ = false;
+  return true;
+}
+
+void MLX90640Component::save_calibration_() {
+  std::unique_ptr<MLX90640CalibrationCache> cache(new MLX90640CalibrationCache);
+  cache->version = CALIBRATION_CACHE_VERSION;
+  memcpy(cache->device_id, this->device_id_, sizeof(this->device_id_));
+  cache->eeprom_hash = this->eeprom_hash_;
+  cache->params = this->mlx90640_params_;
+  if (!this->calibration_pref_.save(cache.get()) ||
+      !global_preferences->sync()) {
+    ESP_LOGW(TAG, "Failed to cache calibration");
+  }
+}
+
+void MLX90640Component::compile_calibration_() {
+  // Only the tables of the kernel in use
+  if (this->fixed_point_) {
+    MLX90640_CompileFixedParameters(&this->mlx90640_params_,
+                                    &this->mlx90640_fixed_);
+  } else if (!this->vectorize_) {
+    if (this->mlx90640_compiled_ == nullptr)
+      this->mlx90640_compiled_.reset(new compiledMLX90640);
+    MLX90640_CompileParameters(&this->mlx90640_params_,
+                               this->mlx90640_compiled_.get());
+  } else {
+    // Built for the configured mode; update() rebuilds it if frames differ
+    if (this->mlx90640_vector_ == nullptr)
+      this->mlx90640_vector_.reset(new vectorMLX90640);
+    MLX90640_CompileVectorParameters(&this->mlx90640_params_,
+                                     this->interleaved_ ? 0x00 : 0x80,
+                                     this->mlx90640_vector_.get());
+  }
+}
+
 void MLX90640Component::loop() {
   PollingComponent::loop();
+  if (this->acquisition_task_handle_ == nullptr) {
+    if (this->acquisition_state_ == AcquisitionState::IDLE &&
+        this->capture_requested_.exchange(false))
+      this->start_frame_();
+    this->acquisition_step_();
+  }
+  // On demand, consumers other than update() are waiting for the frame
+  if ((this->acquisition_task_handle_ == nullptr || this->on_demand_) &&
+      this->frames_.has_new()) {
+    this->frame_ = this->frames_.read();
+    this->publish_frame_();
+  }
+  if (this->acquisition_healthy_)
+    this->status_clear_warning();
+  else
+    this->status_set_warning();
 #ifdef USE_MLX90640_WEB_SERVER
   if (!this->stream_server_started_) {
     // Wait for 10 seconds to ensure network stack (LwIP) is initialized
@@ -92,28 +274,47 @@ void MLX90640Component::loop() {
 
 #ifdef USE_MLX90640_WEB_SERVER
 void MLX90640Component::start_stream_server() {
+  // One server for every sensor on the node, each under its own web_path
   static httpd_handle_t thermal_server = NULL;
+  if (thermal_server == NULL) {
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = 8080;
+    config.ctrl_port = 32769; // Different control port to avoid 32768 conflict
+    config.stack_size = 8192; // Increased stack size for web server handler
+    // Page, .bmp, .raw, .json and stream for each sensor
+    config.max_uri_handlers = 5 * MLX90640_MAX_DEVICES;
 
-  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-  config.server_port = 8080;
-  config.ctrl_port = 32769; // Different control port to avoid 32768 conflict
-  config.stack_size =
-      8192; // Increase stack size to prevent crashes on image processing
-
-  // Lower stack size if needed, but default (4096) is usually safe for this
-  // simple handler
-  config.stack_size = 8192; // Increased stack size for web server handler
+    if (httpd_start(&thermal_server, &config) != ESP_OK) {
+      ESP_LOGE(TAG, "Failed to start Thermal Camera Server");
+      thermal_server = NULL;
+      return;
+    }
+    ESP_LOGI(TAG, "Thermal Camera Server started on port 8080");
+  }
 
-  if (httpd_start(&thermal_server, &config) == ESP_OK) {
-    httpd_uri_t thermal_uri = {.uri = "/thermal.bmp",
+  const struct {
+    const char *suffix;
+    esp_err_t (*handler)(httpd_req_t *req);
+  } endpoints[] = {
+      {"", mlx90640_page_handler},
+      {".bmp", mlx90640_web_server_handler},
+      {".raw", mlx90640_raw_handler},
+      {".json", mlx90640_json_handler},
+  };
+  for (auto &endpoint : endpoints) {
+    std::string uri = this->web_path_ + endpoint.suffix;
+    httpd_uri_t thermal_uri = {.uri = uri.c_str(),
                                .method = HTTP_GET,
-                               .handler = mlx90640_web_server_handler,
+                               .handler = endpoint.handler,
                                .user_ctx = this};
-    httpd_register_uri_handler(thermal_server, &thermal_uri);
-    ESP_LOGI(TAG, "Thermal Camera Server started on port 8080");
-  } else {
-    ESP_LOGE(TAG, "Failed to start Thermal Camera Server");
+    // httpd copies the URI
+    esp_err_t err = httpd_register_uri_handler(thermal_server, &thermal_uri);
+    if (err != ESP_OK)
+      ESP_LOGE(TAG, "Failed to register %s: %s", uri.c_str(),
+               esp_err_to_name(err));
   }
+  ESP_LOGI(TAG, "Thermal viewer at %s", this->web_path_.c_str());
+  this->start_stream_(thermal_server);
 }
 #endif
 
@@ -124,56 +325,341 @@ void MLX90640Component::dump_config() {
   LOG_SENSOR("  ", "Max Temperature", this->max_temperature_sensor_);
   LOG_SENSOR("  ", "Mean Temperature", this->mean_temperature_sensor_);
   LOG_SENSOR("  ", "Median Temperature", this->median_temperature_sensor_);
-  ESP_LOGCONFIG(TAG, "  Refresh Rate: %d Hz", this->refresh_rate_);
+  for (auto &percentile : this->percentile_sensors_) {
+    if (percentile.sensor == this->median_temperature_sensor_)
+      continue;
+    ESP_LOGCONFIG(TAG, "  Percentile %.1f:", percentile.percentile);
+    LOG_SENSOR("    ", "Temperature", percentile.sensor);
+  }
+  ESP_LOGCONFIG(TAG, "  Device ID: %04X%04X%04X", this->device_id_[0],
+                this->device_id_[1], this->device_id_[2]);
+  ESP_LOGCONFIG(TAG, "  Calibration: %s",
+                this->calibration_cached_ ? "cached" : "EEPROM");
+  ESP_LOGCONFIG(TAG, "  Refresh Rate: %.1f Hz",
+                1000.0f /
+                    AcquisitionGovernor::subpage_period_ms(this->rate_code_));
+  if (this->resolution_ >= 0)
+    ESP_LOGCONFIG(TAG, "  Resolution: %d bit", 16 + this->resolution_);
+  if (this->governor_enabled_) {
+    ESP_LOGCONFIG(TAG, "  Governor: up to %d bit",
+                  16 + this->governor_.max_resolution());
+    LOG_SENSOR("    ", "Refresh Rate", this->governor_refresh_rate_sensor_);
+    LOG_SENSOR("    ", "Resolution", this->governor_resolution_sensor_);
+    LOG_SENSOR("    ", "Frame Time", this->governor_frame_time_sensor_);
+    LOG_SENSOR("    ", "CPU Usage", this->governor_cpu_usage_sensor_);
+  }
+  if (this->regions_ != nullptr)
+    ESP_LOGCONFIG(TAG, "  Regions: %u", this->regions_->size());
+  if (this->blobs_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "  Blobs:");
+    LOG_SENSOR("    ", "Count", this->blob_count_sensor_);
+    LOG_SENSOR("    ", "Largest Area", this->blob_largest_area_sensor_);
+    LOG_SENSOR("    ", "Centroid X", this->blob_centroid_x_sensor_);
+    LOG_SENSOR("    ", "Centroid Y", this->blob_centroid_y_sensor_);
+    LOG_SENSOR("    ", "Peak Temperature", this->blob_peak_temperature_sensor_);
+  }
+  if (this->auto_range_ != nullptr)
+    ESP_LOGCONFIG(TAG, "  Auto Range: yes");
+  if (this->setup_frequency_ > 0 || this->stream_frequency_ > 0)
+    ESP_LOGCONFIG(TAG, "  I2C Clock: setup %d kHz, stream %d kHz",
+                  this->setup_frequency_, this->stream_frequency_);
+  ESP_LOGCONFIG(TAG, "  Measurement Mode: %s",
+                this->interleaved_ ? "interleaved" : "chess");
+  ESP_LOGCONFIG(TAG, "  Acquisition: %s%s",
+                this->acquisition_task_handle_ != nullptr ? "task"
+                                                          : "main loop",
+                this->on_demand_ ? ", on demand" : "");
+  if (this->on_demand_)
+    ESP_LOGCONFIG(TAG, "  Frame Cache: %u ms", this->frame_cache_ms_);
+  ESP_LOGCONFIG(TAG, "  To Kernel: %s",
+                this->fixed_point_ ? "fixed-point"
+                : this->mlx90640_vector_ != nullptr
+                    ? (this->fast_math_ ? "float x4 (fast math)" : "float x4")
+                : this->fast_math_ ? "float (fast math)"
+                                   : "float");
 }
 
 void MLX90640Component::update() {
-  int status = MLX90640_GetFrameData(this->address_, this->mlx90640_frame_);
-  if (status < 0) {
-    ESP_LOGW(TAG, "GetFrameData failed! %d", status);
+  if (this->on_demand_) {
+    // loop() publishes the frame once it is in
+    this->request_capture();
+    return;
+  }
+  if (this->acquisition_task_handle_ != nullptr) {
+    // The task acquires continuously; publish whatever it finished last
+    if (this->frames_.has_new()) {
+      this->frame_ = this->frames_.read();
+      this->publish_frame_();
+    }
     return;
   }
 
-  float vdd = MLX90640_GetVdd(this->mlx90640_frame_, &this->mlx90640_params_);
-  float ta = MLX90640_GetTa(this->mlx90640_frame_, &this->mlx90640_params_);
+  // Only starts a frame; loop() drives the acquisition one step at a time
+  if (this->acquisition_state_ != AcquisitionState::IDLE) {
+    ESP_LOGV(TAG, "Previous frame still being acquired");
+    return;
+  }
+  this->start_frame_();
+}
 
-  float tr = ta - 8.0f; // Reflected temperature assumed to be Ta - 8
+void MLX90640Component::start_frame_() {
+  this->subpages_ = 0;
+  this->subpage_reads_ = 0;
+  this->frame_i2c_start_ = *MLX90640_I2CGetStats(this->handle_);
+  this->frame_compute_us_ = 0;
+  this->acquisition_started_ = millis();
+  this->acquisition_state_ = AcquisitionState::WAIT_READY;
+  if (this->on_demand_)
+    this->clear_data_ready_();
+}
+
+void MLX90640Component::clear_data_ready_() {
+  // The sensor kept measuring while nobody read it, so the data-ready flag may
+  // be left over from a subpage measured long ago; clearing it makes the wait
+  // end on the next one
+  int status = MLX90640_I2CWrite(this->handle_, MLX90640_STATUS_REG,
+                                 MLX90640_INIT_STATUS_VALUE);
+  if (status != MLX90640_NO_ERROR)
+    this->acquisition_failed_("clear data ready", status);
+}
 
-  MLX90640_CalculateTo(this->mlx90640_frame_, &this->mlx90640_params_,
-                       this->emissivity_, tr, this->mlx90640_to_);
+bool MLX90640Component::is_fresh(const ThermalImagePool::Ref &image) const {
+  if (!this->on_demand_)
+    return true;
+  return image && millis() - image->timestamp <= this->frame_cache_ms_;
+}
 
-  // ----------------------------------
+void MLX90640Component::request_capture() {
+  if (!this->on_demand_)
+    return;
+  uint32_t last = this->last_capture_;
+  if (last != 0 && millis() - last <= this->frame_cache_ms_)
+    return;
+  this->capture_requested_ = true;
+  this->wake_acquisition_();
+}
 
-  float min_temp = 1000.0f;
-  float max_temp = -1000.0f;
-  float sum_temp = 0.0f;
-  std::vector<float> sorted_temps;
-  sorted_temps.reserve(768);
+ThermalImagePool::Ref MLX90640Component::get_fresh_image() {
+  auto image = this->images_.latest();
+  if (this->is_fresh(image))
+    return image;
+
+  this->request_capture();
+#ifdef USE_ESP32
+  // Two subpages, each possibly waiting out the one in progress
+  const uint32_t timeout = 2 * this->data_ready_timeout_();
+  const uint32_t start = millis();
+  uint32_t elapsed;
+  while (this->image_ready_ != nullptr &&
+         (elapsed = millis() - start) < timeout) {
+    // No pool slot held while the next image is rendered
+    image.reset();
+    if (xSemaphoreTake(this->image_ready_,
+                       pdMS_TO_TICKS(timeout - elapsed)) != pdTRUE)
+      break;
+    image = this->images_.latest();
+    if (this->is_fresh(image)) {
+      // Pass the wakeup on to any other waiter
+      xSemaphoreGive(this->image_ready_);
+      return image;
+    }
+  }
+#endif
+  // A stale image still beats none
+  return this->images_.latest();
+}
+
+void MLX90640Component::wake_acquisition_() {
+#ifdef USE_ESP32
+  if (this->acquisition_task_handle_ != nullptr)
+    xTaskNotifyGive(this->acquisition_task_handle_);
+#endif
+}
+
+#ifdef USE_ESP32
+void MLX90640Component::acquisition_task_fn_(void *param) {
+  auto *self = static_cast<MLX90640Component *>(param);
+  for (;;) {
+    if (self->acquisition_state_ == AcquisitionState::IDLE) {
+      if (self->on_demand_ && !self->capture_requested_.exchange(false)) {
+        // Idle bus and CPU until a consumer asks for a frame
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        continue;
+      }
+      if (self->acquisition_failures_ > 0) {
+        // Back off instead of hammering a sensor that just failed
+        vTaskDelay(pdMS_TO_TICKS(self->data_ready_timeout_()));
+      }
+      self->start_frame_();
+    }
+    self->acquisition_step_();
+    if (self->acquisition_state_ == AcquisitionState::WAIT_READY)
+      vTaskDelay(pdMS_TO_TICKS(ACQUISITION_TASK_POLL_MS));
+  }
+}
+#endif
+
+void MLX90640Component::acquisition_step_() {
+  int status;
+  uint32_t compute_start;
+  switch (this->acquisition_state_) {
+  case AcquisitionState::IDLE:
+    return;
+
+  case AcquisitionState::WAIT_READY:
+    status = MLX90640_GetDataReady(this->handle_, &this->status_register_);
+    if (status < 0) {
+      this->acquisition_failed_("status read", status);
+    } else if (status > 0) {
+      this->acquisition_state_ = AcquisitionState::READ_PIXELS;
+    } else if (millis() - this->acquisition_started_ >
+               this->data_ready_timeout_()) {
+      this->acquisition_failed_("data ready timeout", status);
+    }
+    return;
+
+  case AcquisitionState::READ_PIXELS:
+    if (this->interleaved_) {
+      // Only this subpage's 12 rows changed; roughly halves the pixel traffic
+      status = MLX90640_ReadSubPagePixelData(
+          this->handle_, this->status_register_, this->mlx90640_frame_);
+    } else {
+      status = MLX90640_ReadPixelData(this->handle_, this->status_register_,
+                                      this->mlx90640_frame_);
+    }
+    if (status < 0) {
+      this->acquisition_failed_("pixel read", status);
+      return;
+    }
+    this->acquisition_state_ = AcquisitionState::READ_AUX;
+    return;
+
+  case AcquisitionState::READ_AUX:
+    status = MLX90640_ReadAuxData(this->handle_, this->mlx90640_frame_);
+    if (status < 0) {
+      this->acquisition_failed_("aux read", status);
+      return;
+    }
+    this->acquisition_state_ = AcquisitionState::COMPUTE;
+    return;
+
+  case AcquisitionState::COMPUTE:
+    // Each kernel call only writes the pixels of its own subpage, so
+    // mlx90640_to_ holds a whole frame once both have been converted. A
+    // repeated subpage simply overwrites its stale half.
+    status = this->mlx90640_frame_[833];
+    compute_start = micros();
+    this->subpage_ta_[status] = this->calculate_subpage_();
+    this->frame_compute_us_ += micros() - compute_start;
+    this->subpages_ |= 1 << status;
+    this->subpage_reads_++;
+
+    if (this->subpages_ == 0x03) {
+      this->acquisition_state_ = AcquisitionState::IDLE;
+      this->acquisition_failures_ = 0;
+      this->acquisition_healthy_ = true;
+      this->complete_frame_();
+    } else if (this->subpage_reads_ >= FRAME_ASSEMBLY_ATTEMPTS) {
+      ESP_LOGW(TAG, "Could not capture both subpages, frame dropped");
+      this->acquisition_state_ = AcquisitionState::IDLE;
+    } else {
+      this->acquisition_started_ = millis();
+      this->acquisition_state_ = AcquisitionState::WAIT_READY;
+      if (this->on_demand_)
+        this->clear_data_ready_();
+    }
+    return;
+  }
+}
+
+void MLX90640Component::acquisition_failed_(const char *step, int error) {
+  ESP_LOGW(TAG, "Frame acquisition failed at %s (%d)", step, error);
+  this->acquisition_state_ = AcquisitionState::IDLE;
+  this->acquisition_healthy_ = false;
+
+  if (++this->acquisition_failures_ < ACQUISITION_RECOVERY_FAILURES)
+    return;
+  // Clear a stale data-ready flag and re-apply the refresh rate; the next
+  // update() starts from a clean state either way
+  ESP_LOGW(TAG, "Sensor not responding, reinitialising");
+  this->acquisition_failures_ = 0;
+  MLX90640_I2CWrite(this->handle_, MLX90640_STATUS_REG,
+                    MLX90640_INIT_STATUS_VALUE);
+  this->set_refresh_rate_hw_();
+}
+
+uint32_t MLX90640Component::data_ready_timeout_() const {
+  // Subpage period plus margin for the sensor to finish the one in progress
+  return 3 * AcquisitionGovernor::subpage_period_ms(this->rate_code_) + 100;
+}
 
-  // Lock for buffer modification
-  std::lock_guard<std::mutex> lock(this->image_lock_);
+void MLX90640Component::complete_frame_() {
+  ThermalFrame *frame = this->frames_.write_buffer();
+  memcpy(frame->to, this->mlx90640_to_, sizeof(frame->to));
+  frame->sequence = ++this->frame_sequence_;
+  frame->timestamp = millis();
+  frame->ta = (this->subpage_ta_[0] + this->subpage_ta_[1]) / 2.0f;
+  frame->emissivity = this->emissivity_;
 
-  // Process data & populate image buffer
-  // We'll create an RGB565 buffer directly for the camera
-  // But wait, the camera component typically streams JPEG or RGB565.
-  // Let's stick to RGB888 for simplicity if we can convert, but RGB565 is
-  // standard for embedded LCDs. Actually, for ESPHome Camera, we usually send
-  // the raw image or a JPEG. Let's create an RGB565 buffer.
+  const MLX90640_I2CStats *i2c = MLX90640_I2CGetStats(this->handle_);
+  uint32_t i2c_us = i2c->total_micros - this->frame_i2c_start_.total_micros;
+  ESP_LOGV(TAG, "Frame %u: %u I2C bytes in %u us, converted in %u us",
+           frame->sequence,
+           i2c->total_bytes - this->frame_i2c_start_.total_bytes, i2c_us,
+           this->frame_compute_us_);
 
-  if (this->image_buffer_.size() != 32 * 24 * 2) {
-    this->image_buffer_.resize(32 * 24 * 2);
+  if (this->governor_enabled_ &&
+      this->governor_.frame_done(i2c_us + this->frame_compute_us_,
+                                 this->subpage_reads_)) {
+    // Still on the acquisition side, which owns the bus
+    this->apply_governor_();
+    this->set_refresh_rate_hw_();
   }
+  frame->governor = this->governor_.decision();
+  this->frames_.publish();
+  // Requests made while this frame was acquired are served by it
+  this->last_capture_ = frame->timestamp;
+  this->capture_requested_ = false;
+}
+
+void MLX90640Component::apply_governor_() {
+  const GovernorDecision &decision = this->governor_.decision();
+  this->rate_code_ = decision.rate_code;
+  this->resolution_ = decision.resolution;
+  ESP_LOGI(TAG, "Governor: %.1f Hz, %d bit, every %u ms%s",
+           1000.0f / AcquisitionGovernor::subpage_period_ms(this->rate_code_),
+           16 + this->resolution_, decision.interval_ms,
+           this->governor_.backed_off() ? " (backed off)" : "");
+}
+
+void MLX90640Component::publish_frame_() {
+  const ThermalFrame &frame = *this->frame_;
+
+  // ----------------------------------
+
+  float min_temp = 1000.0f;
+  float max_temp = -1000.0f;
+  float sum_temp = 0.0f;
+  uint16_t finite = 0;
+  if (this->auto_range_ != nullptr)
+    this->auto_range_->reset();
 
   for (int i = 0; i < 768; i++) {
-    float temp = this->mlx90640_to_[i];
+    float temp = frame.to[i];
+    if (this->auto_range_ != nullptr)
+      this->auto_range_->add(temp);
 
     if (temp < min_temp)
       min_temp = temp;
     if (temp > max_temp)
       max_temp = temp;
     sum_temp += temp;
-    sorted_temps.push_back(temp);
+    // NaN breaks nth_element's ordering, so only finite pixels are ranked
+    if (std::isfinite(temp))
+      this->percentile_scratch_[finite++] = temp;
   }
+  if (this->auto_range_ != nullptr)
+    this->auto_range_->finish(frame.timestamp);
 
   if (this->min_temperature_sensor_ != nullptr)
     this->min_temperature_sensor_->publish_state(min_temp);
@@ -182,80 +668,244 @@ void MLX90640Component::update() {
   if (this->mean_temperature_sensor_ != nullptr)
     this->mean_temperature_sensor_->publish_state(sum_temp / 768.0f);
 
-  if (this->median_temperature_sensor_ != nullptr) {
-    std::sort(sorted_temps.begin(), sorted_temps.end());
-    this->median_temperature_sensor_->publish_state(sorted_temps[384]);
+  // Successive selection in ascending rank order: each nth_element only
+  // partitions the part of the scratch buffer above the previous rank.
+  // Nearest rank among the finite pixels, so with all 768 of them the median
+  // is element 384.
+  float *scratch = this->percentile_scratch_;
+  uint16_t lower = 0;
+  for (auto &percentile : this->percentile_sensors_) {
+    if (finite == 0) {
+      percentile.sensor->publish_state(NAN);
+      continue;
+    }
+    uint16_t rank =
+        (uint16_t) lroundf(percentile.percentile / 100.0f * (finite - 1));
+    std::nth_element(scratch + lower, scratch + rank, scratch + finite);
+    percentile.sensor->publish_state(scratch[rank]);
+    lower = rank;
+  }
+
+  if (this->regions_ != nullptr) {
+    this->regions_->update(frame.to);
+    for (uint8_t id = 0; id < this->regions_->size(); id++) {
+      const RegionSensors &sensors = this->region_sensors_[id];
+      ThermalRegions::Stats stats = this->regions_->stats(id);
+      if (sensors.min != nullptr)
+        sensors.min->publish_state(stats.min);
+      if (sensors.max != nullptr)
+        sensors.max->publish_state(stats.max);
+      if (sensors.mean != nullptr)
+        sensors.mean->publish_state(stats.mean);
+    }
+  }
+
+  if (this->blobs_ != nullptr) {
+    const BlobDetector::Result &blobs = this->blobs_->detect(frame.to);
+    if (this->blob_count_sensor_ != nullptr)
+      this->blob_count_sensor_->publish_state(blobs.count);
+    if (this->blob_largest_area_sensor_ != nullptr)
+      this->blob_largest_area_sensor_->publish_state(blobs.largest_area);
+    if (this->blob_centroid_x_sensor_ != nullptr)
+      this->blob_centroid_x_sensor_->publish_state(blobs.centroid_x);
+    if (this->blob_centroid_y_sensor_ != nullptr)
+      this->blob_centroid_y_sensor_->publish_state(blobs.centroid_y);
+    if (this->blob_peak_temperature_sensor_ != nullptr)
+      this->blob_peak_temperature_sensor_->publish_state(blobs.peak);
   }
 
+  if (this->governor_enabled_)
+    this->publish_governor_(frame.governor);
+
+  // Render into a free pool slot; readers keep theirs until they let go
+  ThermalImage *image = this->images_.acquire();
+  if (image == nullptr) {
+    ESP_LOGW(TAG, "All image buffers held by readers, frame not rendered");
+    return;
+  }
+  image->sequence = frame.sequence;
+  image->timestamp = frame.timestamp;
+  image->ta = frame.ta;
+  image->emissivity = frame.emissivity;
+  image->min = min_temp;
+  image->max = max_temp;
+  image->mean = sum_temp / 768.0f;
+
   // Configurable Range with Buffer (matching reference logic)
   const float min_scale = this->min_image_temp_ - 5.0f;
   const float effective_max = this->max_image_temp_ + 5.0f;
   const float scale_range = effective_max - min_scale;
+  // index = temp * index_scale + index_offset
+  const float index_scale = 255.0f / scale_range;
+  const float index_offset = -min_scale * index_scale;
+  const PaletteTable &palette = PALETTES[this->palette_];
+  image->palette = this->palette_;
 
   for (int y = 0; y < 24; y++) {
     for (int x = 0; x < 32; x++) {
       int i = y * 32 + x;
-      float temp = this->mlx90640_to_[i];
+      float temp = frame.to[i];
 
-      // Handle Sensor Errors/Saturation
-      if (std::isnan(temp) || std::isinf(temp) || temp < -40.0f) {
-        temp = effective_max; // Force to Max Hot on error
+      if (std::isfinite(temp)) {
+        image->centi[i] = (int16_t)std::max(
+            -32767L, std::min(32767L, lroundf(temp * 100.0f)));
+      } else {
+        image->centi[i] = THERMAL_RAW_INVALID;
       }
 
-      // Clamp to range
-      if (temp < min_scale)
-        temp = min_scale;
-      if (temp > effective_max)
-        temp = effective_max;
-
-      // Map to 0-255 using the buffered range
-      uint8_t index = (uint8_t)((temp - min_scale) / scale_range * 255.0f);
+      uint8_t index;
+      // Handle Sensor Errors/Saturation
+      if (std::isnan(temp) || std::isinf(temp) || temp < -40.0f) {
+        index = 255; // Force to Max Hot on error
+      } else if (this->auto_range_ != nullptr) {
+        index = this->auto_range_->index(temp);
+      } else {
+        // Clamp to range
+        if (temp < min_scale)
+          temp = min_scale;
+        if (temp > effective_max)
+          temp = effective_max;
 
-      // Lookup 565 Color
-      uint16_t color = camColors[index];
+        // Map to 0-255 using the buffered range
+        index = (uint8_t)(temp * index_scale + index_offset);
+      }
+      image->index[i] = index;
 
       // Debug: Log center pixel details occasionally
       // i = 384 is approx center (12 * 32 = 384)
       if (i == 384) {
         // Log every ~2 seconds (every 4th frame at 2Hz)
-        static int log_skipper = 0;
-        if (log_skipper++ % 4 == 0) {
+        if (this->log_skipper_++ % 4 == 0) {
           ESP_LOGD(TAG,
                    "Center Pixel (index 384): Temp=%.2f C, MappedIndex=%d, "
-                   "Color=0x%04X [MinScale=%.2f, MaxScale=%.2f]",
-                   this->mlx90640_to_[i], index, color, min_scale,
+                   "Color=0x%02X%02X [MinScale=%.2f, MaxScale=%.2f]",
+                   frame.to[i], index, palette.rgb565[index][0],
+                   palette.rgb565[index][1], min_scale,
                    effective_max);
         }
       }
 
       // Store in buffer (RGB565 Big Endian)
-      this->image_buffer_[i * 2] = (uint8_t)(color >> 8);
-      this->image_buffer_[i * 2 + 1] = (uint8_t)(color & 0xFF);
+      memcpy(image->rgb565 + i * 2, palette.rgb565[index], 2);
     }
   }
+
+  this->images_.publish();
+#ifdef USE_ESP32
+  if (this->image_ready_ != nullptr)
+    xSemaphoreGive(this->image_ready_);
+#endif
+#ifdef USE_MLX90640_WEB_SERVER
+  if (this->stream_task_handle_ != nullptr)
+    xTaskNotifyGive(this->stream_task_handle_);
+#endif
 }
 
-void MLX90640Component::set_refresh_rate_hw_() {
-  // Basic mapping, needs checking against datasheet
-  // 0x00: 0.5Hz, 0x01: 1Hz, 0x02: 2Hz, 0x03: 4Hz, 0x04: 8Hz, 0x05: 16Hz...
-  int rate_code = 2; // Default 2Hz
-  if (this->refresh_rate_ <= 1)
-    rate_code = 1;
-  else if (this->refresh_rate_ <= 2)
-    rate_code = 2;
-  else if (this->refresh_rate_ <= 4)
-    rate_code = 3;
-  else if (this->refresh_rate_ <= 8)
-    rate_code = 4;
-  else
-    rate_code = 5; // 16Hz max typically for ESP
+float MLX90640Component::calculate_subpage_() {
+  float ta = MLX90640_GetTa(this->mlx90640_frame_, &this->mlx90640_params_);
+
+  float tr = ta - 8.0f; // Reflected temperature assumed to be Ta - 8
+
+  if (this->fixed_point_) {
+    MLX90640_CalculateToFixed(this->mlx90640_frame_, &this->mlx90640_params_,
+                              &this->mlx90640_fixed_, this->emissivity_, tr,
+                              this->mlx90640_to_);
+  } else if (this->mlx90640_vector_ != nullptr) {
+    if (MLX90640_CalculateToVector(this->mlx90640_frame_,
+                                   &this->mlx90640_params_,
+                                   this->mlx90640_vector_.get(),
+                                   this->emissivity_, tr, this->fast_math_,
+                                   this->mlx90640_to_) < 0) {
+      uint8_t mode =
+          (this->mlx90640_frame_[832] & MLX90640_CTRL_MEAS_MODE_MASK) >> 5;
+      ESP_LOGD(TAG, "Rebuilding vector tables for measurement mode %u", mode);
+      MLX90640_CompileVectorParameters(&this->mlx90640_params_, mode,
+                                       this->mlx90640_vector_.get());
+      MLX90640_CalculateToVector(this->mlx90640_frame_,
+                                 &this->mlx90640_params_,
+                                 this->mlx90640_vector_.get(),
+                                 this->emissivity_, tr, this->fast_math_,
+                                 this->mlx90640_to_);
+    }
+  } else if (this->fast_math_) {
+    MLX90640_CalculateToFast(this->mlx90640_frame_, &this->mlx90640_params_,
+                             this->mlx90640_compiled_.get(), this->emissivity_, tr,
+                             this->mlx90640_to_);
+  } else {
+    MLX90640_CalculateToCompiled(this->mlx90640_frame_, &this->mlx90640_params_,
+                                 this->mlx90640_compiled_.get(),
+                                 this->emissivity_, tr, this->mlx90640_to_);
+  }
+
+  return ta;
+}
+
+void MLX90640Component::publish_governor_(const GovernorDecision &decision) {
+  if (decision.interval_ms != this->get_update_interval()) {
+    this->set_update_interval(decision.interval_ms);
+    this->stop_poller();
+    this->start_poller();
+  }
+  if (this->governor_refresh_rate_sensor_ != nullptr)
+    this->governor_refresh_rate_sensor_->publish_state(
+        1000.0f / AcquisitionGovernor::subpage_period_ms(decision.rate_code));
+  if (this->governor_resolution_sensor_ != nullptr)
+    this->governor_resolution_sensor_->publish_state(16 + decision.resolution);
+  if (this->governor_frame_time_sensor_ != nullptr)
+    this->governor_frame_time_sensor_->publish_state(decision.cost_us /
+                                                     1000.0f);
+  if (this->governor_cpu_usage_sensor_ != nullptr)
+    this->governor_cpu_usage_sensor_->publish_state(decision.cpu_usage *
+                                                    100.0f);
+}
+
+void MLX90640Component::add_percentile_sensor(float percentile,
+                                              sensor::Sensor *s) {
+  PercentileSensor entry{percentile, s};
+  auto pos = std::upper_bound(
+      this->percentile_sensors_.begin(), this->percentile_sensors_.end(),
+      entry, [](const PercentileSensor &a, const PercentileSensor &b) {
+        return a.percentile < b.percentile;
+      });
+  this->percentile_sensors_.insert(pos, entry);
+}
+
+void MLX90640Component::add_region(int x, int y, int width, int height,
+                                   sensor::Sensor *min, sensor::Sensor *max,
+                                   sensor::Sensor *mean) {
+  if (this->regions_ == nullptr)
+    this->regions_.reset(new ThermalRegions);
+  this->add_region_sensors_(this->regions_->add_rect(x, y, width, height),
+                            {min, max, mean});
+}
+
+void MLX90640Component::add_region_mask(int x, int y,
+                                        const std::vector<std::string> &rows,
+                                        sensor::Sensor *min,
+                                        sensor::Sensor *max,
+                                        sensor::Sensor *mean) {
+  if (this->regions_ == nullptr)
+    this->regions_.reset(new ThermalRegions);
+  this->add_region_sensors_(this->regions_->add_mask(x, y, rows),
+                            {min, max, mean});
+}
 
-  MLX90640_SetRefreshRate(this->address_, rate_code);
+void MLX90640Component::add_region_sensors_(int id,
+                                            const RegionSensors &sensors) {
+  if (id < 0) {
+    ESP_LOGE(TAG, "Region ignored: empty, or more than %d regions",
+             ThermalRegions::MAX_REGIONS);
+    return;
+  }
+  this->region_sensors_.resize(id + 1);
+  this->region_sensors_[id] = sensors;
 }
 
-void MLX90640Component::get_image_data(std::vector<uint8_t> &data) {
-  std::lock_guard<std::mutex> lock(this->image_lock_);
-  data = this->image_buffer_;
+void MLX90640Component::set_refresh_rate_hw_() {
+  // 0x00: 0.5Hz, 0x01: 1Hz, 0x02: 2Hz, ... 0x07: 64Hz
+  MLX90640_SetRefreshRate(this->handle_, this->rate_code_);
+  if (this->resolution_ >= 0)
+    MLX90640_SetResolution(this->handle_, this->resolution_);
 }
 
 #ifdef USE_MLX90640_CAMERA
@@ -265,15 +915,33 @@ void MLX90640Camera::setup() {
 }
 
 void MLX90640Camera::loop() {
-  // Nothing special needed
+  if (this->pending_ && this->parent_->is_fresh(this->parent_->get_image())) {
+    this->pending_ = false;
+    this->send_image_(this->pending_requester_);
+  }
 }
 
 void MLX90640Camera::request_image(camera::CameraRequester requester) {
   if (this->parent_ == nullptr)
     return;
 
-  std::vector<uint8_t> data;
-  this->parent_->get_image_data(data);
+  if (!this->parent_->is_fresh(this->parent_->get_image())) {
+    // The main loop renders the frame, so wait for it in loop()
+    this->pending_ = true;
+    this->pending_requester_ = requester;
+    this->parent_->request_capture();
+    return;
+  }
+  this->send_image_(requester);
+}
+
+void MLX90640Camera::send_image_(camera::CameraRequester requester) {
+  auto snapshot = this->parent_->get_image();
+  if (!snapshot)
+    return;
+  // CameraImage owns its bytes, so this is the one copy left on this path
+  std::vector<uint8_t> data(snapshot->rgb565,
+                            snapshot->rgb565 + sizeof(snapshot->rgb565));
 
   auto image = std::make_unique<camera::CameraImage>(std::move(data), 32, 24);
   this->callback_manager_.call(std::move(image), requester);
@@ -283,124 +951,447 @@ void MLX90640Camera::request_image(camera::CameraRequester requester) {
 #ifdef USE_MLX90640_WEB_SERVER
 #include <esp_http_server.h>
 
-esp_err_t mlx90640_web_server_handler(httpd_req_t *req) {
-  // Retrieve the component instance from user_ctx
-  MLX90640Component *component = (MLX90640Component *)req->user_ctx;
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "/thermal.raw sends ThermalImage::centi as is");
 
-  // Create BMP header and data
-  // 32x24 pixels, 3 bytes per pixel (RGB888) = 2304 bytes
-  // Header = 54 bytes
-  const int width = 32;
-  const int height = 24;
-  const int row_padded = (width * 3 + 3) & (~3);
-  const int data_size = row_padded * height;
-  const int file_size = 54 + data_size;
+#define STREAM_BOUNDARY "mlx90640frame"
+static const char *const STREAM_CONTENT_TYPE =
+    "multipart/x-mixed-replace;boundary=" STREAM_BOUNDARY;
+static const uint32_t STREAM_TASK_STACK_SIZE = 4096;
+static const UBaseType_t STREAM_TASK_PRIORITY = 1;
+// Longest a watched stream sleeps without a new image, e.g. between captures
+// on demand
+static const uint32_t STREAM_IDLE_MS = 1000;
 
-  // Use global buffer to persist data for send
-  if (g_bmp_buffer.size() != file_size) {
-    g_bmp_buffer.resize(file_size);
-  }
-  uint8_t *buf = g_bmp_buffer.data();
+static void put_le32(uint8_t *buf, uint32_t value) {
+  buf[0] = (uint8_t)(value);
+  buf[1] = (uint8_t)(value >> 8);
+  buf[2] = (uint8_t)(value >> 16);
+  buf[3] = (uint8_t)(value >> 24);
+}
+
+static int bmp_row_size(int width) { return (width * 3 + 3) & ~3; }
+
+// 54-byte header of a 24-bit bottom-up BMP
+static void write_bmp_header(uint8_t *buf, int width, int height) {
+  const int data_size = bmp_row_size(width) * height;
+  memset(buf, 0, BMP_HEADER_SIZE);
 
   // BMP Header
   buf[0] = 'B';
-  buf[1] = 'M'; // Signature
-  buf[2] = (uint8_t)(file_size);
-  buf[3] = (uint8_t)(file_size >> 8);
-  buf[4] = (uint8_t)(file_size >> 16);
-  buf[5] = (uint8_t)(file_size >> 24); // File size
-  buf[10] = 54;
-  buf[11] = 0;
-  buf[12] = 0;
-  buf[13] = 0; // Offset to data
+  buf[1] = 'M';                                  // Signature
+  put_le32(buf + 2, BMP_HEADER_SIZE + data_size); // File size
+  put_le32(buf + 10, BMP_HEADER_SIZE);           // Offset to data
 
   // DIB Header
-  buf[14] = 40;
-  buf[15] = 0;
-  buf[16] = 0;
-  buf[17] = 0; // Header size
-  buf[18] = width;
-  buf[19] = 0;
-  buf[20] = 0;
-  buf[21] = 0; // Width
-  buf[22] = height;
-  buf[23] = 0;
-  buf[24] = 0;
-  buf[25] = 0; // Height (positive bottom-up)
-
-  buf[26] = 1;
-  buf[27] = 0; // Planes
-  buf[28] = 24;
-  buf[29] = 0; // Bits per pixel
-  buf[30] = 0;
-  buf[31] = 0;
-  buf[32] = 0;
-  buf[33] = 0; // Compression
-  buf[34] = (uint8_t)(data_size);
-  buf[35] = (uint8_t)(data_size >> 8);
-  buf[36] = (uint8_t)(data_size >> 16);
-  buf[37] = (uint8_t)(data_size >> 24); // Image size
-
-  // Construct Data (Convert RGB565 buffer to RGB888 and flip Y for BMP
-  // bottom-up)
-  std::vector<uint8_t> rgb565_data;
-  component->get_image_data(rgb565_data);
-
-  // Safety check
-  if (rgb565_data.size() < width * height * 2) {
-    httpd_resp_send_500(req);
-    return ESP_FAIL;
+  put_le32(buf + 14, 40);     // Header size
+  put_le32(buf + 18, width);  // Width
+  put_le32(buf + 22, height); // Height (positive bottom-up)
+  buf[26] = 1;                // Planes
+  buf[28] = 24;               // Bits per pixel
+  // Compression 0
+  put_le32(buf + 34, data_size); // Image size
+}
+
+// One image row in BMP byte order, straight from the palette
+static void bgr_row(const ThermalImage &image, int y, uint8_t *bgr) {
+  const PaletteTable &palette = PALETTES[image.palette];
+  const uint8_t *index = image.index + y * REQUEST_IMAGE_WIDTH;
+  for (int x = 0; x < REQUEST_IMAGE_WIDTH; x++)
+    memcpy(bgr + x * 3, palette.bgr888[index[x]], 3);
+}
+
+static void encode_bmp(const ThermalImage &image, uint8_t *buf) {
+  // 32x24 pixels, 3 bytes per pixel (RGB888) = 2304 bytes
+  // Header = 54 bytes
+  const int width = REQUEST_IMAGE_WIDTH;
+  const int height = REQUEST_IMAGE_HEIGHT;
+  write_bmp_header(buf, width, height);
+
+  uint8_t *p_data = buf + BMP_HEADER_SIZE;
+  for (int y = height - 1; y >= 0; y--) { // BMP is bottom-up
+    bgr_row(image, y, p_data);
+    p_data += width * 3;
+    // Padding
+    memset(p_data, 0, BMP_ROW_SIZE - width * 3);
+    p_data += BMP_ROW_SIZE - width * 3;
   }
+}
+
+// Source coordinate of output pixel i, pixel centres aligned, in Q8 and
+// clamped to the source edge
+static int32_t bmp_source_q8(int i, int scale, int size) {
+  int32_t pos = (int32_t)(2 * i + 1) * 128 / scale - 128;
+  return std::max<int32_t>(0, std::min<int32_t>(pos, (size - 1) * 256));
+}
+
+// Streams the image upscaled by scale as a BMP with chunked encoding, one
+// output row at a time through a fixed stack buffer, so memory use does not
+// depend on the output size. Bilinear in Q8 fixed point: each output row
+// blends two source rows once, then each pixel blends two columns of that.
+// Returns the send result and the time spent interpolating.
+static esp_err_t send_scaled_bmp(httpd_req_t *req, const ThermalImage &image,
+                                 int scale, uint32_t *compute_us) {
+  const int src_w = REQUEST_IMAGE_WIDTH;
+  const int src_h = REQUEST_IMAGE_HEIGHT;
+  const int width = src_w * scale;
+  const int height = src_h * scale;
+  const int padding = bmp_row_size(width) - width * 3;
+
+  uint8_t chunk[BMP_CHUNK_SIZE];
+  static_assert(BMP_CHUNK_SIZE >= BMP_HEADER_SIZE, "header fits a chunk");
+  write_bmp_header(chunk, width, height);
+  size_t used = BMP_HEADER_SIZE;
+
+  uint8_t top[REQUEST_IMAGE_WIDTH * 3], bottom[REQUEST_IMAGE_WIDTH * 3];
+  uint16_t blended[REQUEST_IMAGE_WIDTH * 3]; // Q8
+  int decoded_y0 = -1;
+
+  // compute_us is everything but the sends, so the clock is read once per
+  // chunk rather than per pixel
+  *compute_us = 0;
+  uint32_t start = micros();
+  auto send_chunk = [&]() {
+    *compute_us += micros() - start;
+    esp_err_t err = httpd_resp_send_chunk(req, (const char *)chunk, used);
+    used = 0;
+    start = micros();
+    return err == ESP_OK;
+  };
 
-  uint8_t *p_data = buf + 54;
   for (int y = height - 1; y >= 0; y--) { // BMP is bottom-up
+    int32_t sy = bmp_source_q8(y, scale, src_h);
+    int y0 = sy >> 8;
+    int y1 = std::min(y0 + 1, src_h - 1);
+    uint32_t fy = sy & 0xFF;
+    if (y0 != decoded_y0) {
+      bgr_row(image, y0, top);
+      bgr_row(image, y1, bottom);
+      decoded_y0 = y0;
+    }
+    for (int i = 0; i < src_w * 3; i++)
+      blended[i] = top[i] * (256 - fy) + bottom[i] * fy;
+
     for (int x = 0; x < width; x++) {
-      int i = (y * width + x) * 2;
-      uint16_t color565 = (rgb565_data[i] << 8) | rgb565_data[i + 1];
-
-      // RGB565 -> RGB888
-      // RGB565 -> RGB888 (Reference: Chill-Division/M5Stack-ESPHome)
-      // Uses optimized integer arithmetic: (x * 527 + 23) >> 6 approx x * 255 /
-      // 31
-      uint8_t r_565 = (color565 >> 11) & 0x1F;
-      uint8_t g_565 = (color565 >> 5) & 0x3F;
-      uint8_t b_565 = color565 & 0x1F;
-
-      // Reference Math:
-      // red = ((((color >> 11) & 0x1F) * 527) + 23) >> 6;
-      // green = ((((color >> 5) & 0x3F) * 259) + 33) >> 6;
-      // blue = (((color & 0x1F) * 527) + 23) >> 6;
-
-      uint8_t r = (r_565 * 527 + 23) >> 6;
-      uint8_t g = (g_565 * 259 + 33) >> 6;
-      uint8_t b = (b_565 * 527 + 23) >> 6;
-
-      // Clamp (though math shouldn't overflow theoretically for valid 5/6 bit
-      // inputs)
-      if (r > 255)
-        r = 255;
-      if (g > 255)
-        g = 255;
-      if (b > 255)
-        b = 255;
-
-      // BMP is BGR
-      *p_data++ = b;
-      *p_data++ = g;
-      *p_data++ = r;
+      if (used + 3 > sizeof(chunk) && !send_chunk())
+        return ESP_FAIL;
+      int32_t sx = bmp_source_q8(x, scale, src_w);
+      const uint16_t *left = blended + (sx >> 8) * 3;
+      const uint16_t *right =
+          blended + std::min((sx >> 8) + 1, src_w - 1) * 3;
+      uint32_t fx = sx & 0xFF;
+      for (int c = 0; c < 3; c++)
+        chunk[used++] =
+            (left[c] * (256 - fx) + right[c] * fx + 0x8000) >> 16;
     }
-    // Padding
-    for (int p = 0; p < (row_padded - width * 3); p++) {
-      *p_data++ = 0;
+    for (int p = 0; p < padding; p++) {
+      if (used == sizeof(chunk) && !send_chunk())
+        return ESP_FAIL;
+      chunk[used++] = 0;
     }
   }
+  if (used > 0 && !send_chunk())
+    return ESP_FAIL;
+  return httpd_resp_send_chunk(req, nullptr, 0);
+}
+
+// ?scale=N from the query string, 1 when absent or out of range
+static int requested_scale(httpd_req_t *req) {
+  char query[32], value[8];
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+      httpd_query_key_value(query, "scale", value, sizeof(value)) != ESP_OK)
+    return 1;
+  int scale = atoi(value);
+  return scale >= 1 && scale <= BMP_MAX_SCALE ? scale : 1;
+}
+
+// Sets the frame's ETag (etag must outlive the response) and, when the
+// client already has that frame, the 304 status to send with an empty body.
+// One ETag per frame, so clients polling faster than the sensor get 304s.
+static const size_t ETAG_SIZE = 24;
+static bool not_modified(httpd_req_t *req, uint32_t boot_id, uint32_t sequence,
+                         char *etag) {
+  snprintf(etag, ETAG_SIZE, "\"%08x-%u\"", (unsigned)boot_id,
+           (unsigned)sequence);
+  httpd_resp_set_hdr(req, "ETag", etag);
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  char if_none_match[64];
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match,
+                                  sizeof(if_none_match)) == ESP_OK &&
+      strstr(if_none_match, etag) != nullptr) {
+    httpd_resp_set_status(req, "304 Not Modified");
+    return true;
+  }
+  return false;
+}
+
+ThermalBmpPool::Ref MLX90640Component::encoded_bmp_(const ThermalImage &image) {
+  auto bmp = this->bmps_.latest();
+  if (bmp && bmp->sequence == image.sequence)
+    return bmp;
+
+  // The first request for a frame encodes it; concurrent ones wait for that
+  // instead of encoding it again
+  std::lock_guard<std::mutex> lock(this->bmp_mutex_);
+  bmp = this->bmps_.latest();
+  if (bmp && bmp->sequence == image.sequence)
+    return bmp;
+  ThermalBmp *slot = this->bmps_.acquire();
+  if (slot == nullptr) {
+    bmp.reset();
+    return bmp;
+  }
+  encode_bmp(image, slot->data);
+  slot->sequence = image.sequence;
+  this->bmps_.publish();
+  return this->bmps_.latest();
+}
+
+esp_err_t mlx90640_web_server_handler(httpd_req_t *req) {
+  // Retrieve the component instance from user_ctx
+  MLX90640Component *component = (MLX90640Component *)req->user_ctx;
+
+  // Read the latest image in place; the slot is held until we return
+  auto image = component->get_fresh_image();
+  if (!image) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+
+  char etag[ETAG_SIZE];
+  if (not_modified(req, component->boot_id_, image->sequence, etag))
+    return httpd_resp_send(req, nullptr, 0);
 
   httpd_resp_set_type(req, "image/bmp");
-  // httpd_resp_send works with a single buffer.
-  httpd_resp_send(req, (const char *)buf, file_size);
+  int scale = requested_scale(req);
+  if (scale > 1) {
+    uint32_t start = micros();
+    uint32_t compute_us;
+    esp_err_t err = send_scaled_bmp(req, *image, scale, &compute_us);
+    ESP_LOGD(TAG, "%dx%d BMP: %u us interpolating, %u us total",
+             REQUEST_IMAGE_WIDTH * scale, REQUEST_IMAGE_HEIGHT * scale,
+             (unsigned)compute_us, (unsigned)(micros() - start));
+    return err;
+  }
+
+  // Native size: the frame's shared encoding, as the stream sends it
+  auto bmp = component->encoded_bmp_(*image);
+  if (!bmp) {
+    ESP_LOGW(TAG, "All BMP buffers in use");
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  return httpd_resp_send(req, (const char *)bmp->data, sizeof(bmp->data));
+}
+
+esp_err_t mlx90640_raw_handler(httpd_req_t *req) {
+  MLX90640Component *component = (MLX90640Component *)req->user_ctx;
+  auto image = component->get_fresh_image();
+  if (!image) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  char etag[ETAG_SIZE];
+  if (not_modified(req, component->boot_id_, image->sequence, etag))
+    return httpd_resp_send(req, nullptr, 0);
+
+  // Frame metadata travels in headers so the body is just the 32x24 pixels
+  char sequence[12], timestamp[12], ta[12], emissivity[12];
+  snprintf(sequence, sizeof(sequence), "%u", (unsigned)image->sequence);
+  snprintf(timestamp, sizeof(timestamp), "%u", (unsigned)image->timestamp);
+  snprintf(ta, sizeof(ta), "%.2f", image->ta);
+  snprintf(emissivity, sizeof(emissivity), "%.3f", image->emissivity);
+  httpd_resp_set_hdr(req, "X-Thermal-Sequence", sequence);
+  httpd_resp_set_hdr(req, "X-Thermal-Timestamp", timestamp);
+  httpd_resp_set_hdr(req, "X-Thermal-Ta", ta);
+  httpd_resp_set_hdr(req, "X-Thermal-Emissivity", emissivity);
+  httpd_resp_set_hdr(req, "X-Thermal-Size", "32x24");
+  httpd_resp_set_type(req, "application/octet-stream");
+  // Straight from the pool slot, held until we return
+  return httpd_resp_send(req, (const char *)image->centi,
+                         sizeof(image->centi));
+}
+
+// JSON number, or null for a missing reading
+static const char *json_float(char *buf, size_t len, float value,
+                              int decimals) {
+  if (!std::isfinite(value))
+    return "null";
+  snprintf(buf, len, "%.*f", decimals, value);
+  return buf;
+}
+
+esp_err_t mlx90640_json_handler(httpd_req_t *req) {
+  MLX90640Component *component = (MLX90640Component *)req->user_ctx;
+  auto image = component->get_fresh_image();
+  if (!image) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  char etag[ETAG_SIZE];
+  if (not_modified(req, component->boot_id_, image->sequence, etag))
+    return httpd_resp_send(req, nullptr, 0);
+
+  char ta[12], emissivity[12], min[12], max[12], mean[12];
+  char json[256];
+  int len = snprintf(
+      json, sizeof(json),
+      "{\"sequence\":%u,\"timestamp\":%u,\"width\":%u,\"height\":%u,"
+      "\"ta\":%s,\"emissivity\":%s,\"min\":%s,\"max\":%s,\"mean\":%s}",
+      (unsigned)image->sequence, (unsigned)image->timestamp,
+      REQUEST_IMAGE_WIDTH, REQUEST_IMAGE_HEIGHT,
+      json_float(ta, sizeof(ta), image->ta, 2),
+      json_float(emissivity, sizeof(emissivity), image->emissivity, 3),
+      json_float(min, sizeof(min), image->min, 2),
+      json_float(max, sizeof(max), image->max, 2),
+      json_float(mean, sizeof(mean), image->mean, 2));
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, json, len);
+}
+
+esp_err_t mlx90640_page_handler(httpd_req_t *req) {
+  httpd_resp_set_type(req, "text/html");
+  return httpd_resp_send(req, THERMAL_PAGE_HTML, sizeof(THERMAL_PAGE_HTML) - 1);
+}
+
+void MLX90640Component::start_stream_(httpd_handle_t server) {
+#ifdef MLX90640_STREAM
+  if (this->stream_max_clients_ == 0)
+    return;
+  this->stream_queue_ =
+      xQueueCreate(this->stream_max_clients_, sizeof(httpd_req_t *));
+  if (this->stream_queue_ == nullptr ||
+      xTaskCreate(MLX90640Component::stream_task_fn_, "mlx90640_stream",
+                  STREAM_TASK_STACK_SIZE, this, STREAM_TASK_PRIORITY,
+                  &this->stream_task_handle_) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to start the stream task");
+    this->stream_task_handle_ = nullptr;
+    return;
+  }
+
+  std::string uri = this->web_path_ + "/stream";
+  httpd_uri_t stream_uri = {.uri = uri.c_str(),
+                            .method = HTTP_GET,
+                            .handler = mlx90640_stream_handler,
+                            .user_ctx = this};
+  esp_err_t err = httpd_register_uri_handler(server, &stream_uri);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to register %s: %s", uri.c_str(),
+             esp_err_to_name(err));
+    return;
+  }
+  ESP_LOGI(TAG, "Thermal stream at %s", uri.c_str());
+#else
+  ESP_LOGW(TAG, "Streaming needs ESP-IDF 5.2 or later");
+#endif
+}
+
+esp_err_t mlx90640_stream_handler(httpd_req_t *req) {
+#ifdef MLX90640_STREAM
+  MLX90640Component *component = (MLX90640Component *)req->user_ctx;
+  if (component->stream_clients_.fetch_add(1) >=
+      component->stream_max_clients_) {
+    component->stream_clients_--;
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    return httpd_resp_send(req, "Too many stream clients",
+                           HTTPD_RESP_USE_STRLEN);
+  }
+
+  // Keep the request open past this handler; the stream task answers it
+  httpd_req_t *client;
+  if (httpd_req_async_handler_begin(req, &client) != ESP_OK) {
+    component->stream_clients_--;
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  httpd_resp_set_type(client, STREAM_CONTENT_TYPE);
+  httpd_resp_set_hdr(client, "Cache-Control", "no-cache");
+  // The queue holds stream_max_clients_, which the count above bounds
+  xQueueSend(component->stream_queue_, &client, 0);
+  xTaskNotifyGive(component->stream_task_handle_);
   return ESP_OK;
+#else
+  httpd_resp_send_404(req);
+  return ESP_FAIL;
+#endif
+}
+
+#ifdef MLX90640_STREAM
+void MLX90640Component::stream_task_fn_(void *param) {
+  auto *self = static_cast<MLX90640Component *>(param);
+  std::vector<httpd_req_t *> clients;
+  std::vector<uint32_t> sent; // frame sequence each client has last been sent
+  const uint32_t min_interval_ms =
+      self->stream_max_fps_ > 0.0f ? (uint32_t)(1000.0f / self->stream_max_fps_)
+                                   : 0;
+  uint32_t last_frame = 0;
+
+  for (;;) {
+    // Woken by new clients and new images
+    ulTaskNotifyTake(pdTRUE, clients.empty() ? portMAX_DELAY
+                                             : pdMS_TO_TICKS(STREAM_IDLE_MS));
+    httpd_req_t *client;
+    while (xQueueReceive(self->stream_queue_, &client, 0) == pdTRUE) {
+      clients.push_back(client);
+      sent.push_back(0);
+    }
+    if (clients.empty())
+      continue;
+
+    // On demand, a watched stream keeps asking for frames
+    self->request_capture();
+    // Frame-rate cap; images published meanwhile collapse into the latest
+    uint32_t elapsed = millis() - last_frame;
+    if (elapsed < min_interval_ms)
+      vTaskDelay(pdMS_TO_TICKS(min_interval_ms - elapsed));
+    last_frame = millis();
+    self->send_stream_frame_(clients, sent);
+  }
+}
+
+void MLX90640Component::send_stream_frame_(std::vector<httpd_req_t *> &clients,
+                                           std::vector<uint32_t> &sent) {
+  ThermalBmpPool::Ref bmp;
+  {
+    auto image = this->images_.latest();
+    if (!image)
+      return;
+    bmp = this->encoded_bmp_(*image);
+  }
+  if (!bmp)
+    return;
+
+  char part[96];
+  int part_len = snprintf(part, sizeof(part),
+                          "--%s\r\nContent-Type: image/bmp\r\n"
+                          "Content-Length: %d\r\n\r\n",
+                          STREAM_BOUNDARY, BMP_FILE_SIZE);
+  for (size_t i = 0; i < clients.size();) {
+    httpd_req_t *client = clients[i];
+    if (sent[i] == bmp->sequence) {
+      i++;
+      continue;
+    }
+    if (httpd_resp_send_chunk(client, part, part_len) == ESP_OK &&
+        httpd_resp_send_chunk(client, (const char *)bmp->data,
+                              sizeof(bmp->data)) == ESP_OK &&
+        httpd_resp_send_chunk(client, "\r\n", 2) == ESP_OK) {
+      sent[i++] = bmp->sequence;
+      continue;
+    }
+
+    // Client gone: hand the request back and close its socket
+    httpd_handle_t server = client->handle;
+    int fd = httpd_req_to_sockfd(client);
+    httpd_req_async_handler_complete(client);
+    httpd_sess_trigger_close(server, fd);
+    clients.erase(clients.begin() + i);
+    sent.erase(sent.begin() + i);
+    this->stream_clients_--;
+  }
 }
 #endif
+#endif
 
 } // namespace mlx90640
 } // namespace esphome
@@ -9,14 +9,38 @@
 #include "esphome/components/i2c/i2c.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/core/component.h"
-#include <mutex>
+#include "esphome/core/preferences.h"
+#include <cmath>
+#include <memory>
 
 #ifdef USE_MLX90640_WEB_SERVER
 #include "esphome/components/web_server/web_server.h"
+#include <esp_http_server.h>
+#include <esp_idf_version.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <mutex>
+#include <string>
+// Streaming keeps each client's request open past its handler
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+#define MLX90640_STREAM
+#endif
 #endif
 
 #include "MLX90640_API.h"
 #include "MLX90640_I2C_Driver.h"
+#include "frame_pool.h"
+#include "auto_range.h"
+#include "blobs.h"
+#include "governor.h"
+#include "regions.h"
+#include "triple_buffer.h"
+
+#ifdef USE_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#endif
 
 #include <vector>
 
@@ -26,6 +50,94 @@ namespace mlx90640 {
 static const uint16_t REQUEST_IMAGE_WIDTH = 32;
 static const uint16_t REQUEST_IMAGE_HEIGHT = 24;
 
+// One complete frame assembled from both subpages
+struct ThermalFrame {
+  float to[768];
+  uint32_t sequence{0};  // 0 until the first frame is complete
+  uint32_t timestamp{0}; // millis() when the frame was completed
+  float ta{NAN};         // mean ambient temperature of the two subpages
+  float emissivity{0.0f};
+  GovernorDecision governor; // acquisition settings it was taken with
+};
+
+// Rendered RGB565 image of one frame, shared read-only with the web handler
+// and camera through FramePool
+struct ThermalImage {
+  uint32_t sequence{0};  // ThermalFrame::sequence it was rendered from
+  uint32_t timestamp{0};
+  float ta{NAN};
+  float emissivity{0.0f};
+  float min{NAN};
+  float max{NAN};
+  float mean{NAN};
+  uint8_t palette{0}; // ThermalPalette it was rendered with
+  uint8_t rgb565[REQUEST_IMAGE_WIDTH * REQUEST_IMAGE_HEIGHT * 2]; // big endian
+  // Palette index per pixel, for outputs in other colour formats
+  uint8_t index[REQUEST_IMAGE_WIDTH * REQUEST_IMAGE_HEIGHT];
+  // Radiometric copy served by /thermal.raw as is: row-major centi-degrees C,
+  // little endian, THERMAL_RAW_INVALID where the pixel has no temperature
+  int16_t centi[REQUEST_IMAGE_WIDTH * REQUEST_IMAGE_HEIGHT];
+};
+static const int16_t THERMAL_RAW_INVALID = INT16_MIN;
+// Latest image, one being rendered, and room for readers still holding older
+static const uint8_t IMAGE_POOL_SIZE = 4;
+using ThermalImagePool = FramePool<ThermalImage, IMAGE_POOL_SIZE>;
+
+#ifdef USE_MLX90640_WEB_SERVER
+// 24-bit bottom-up BMP of one ThermalImage, encoded once per frame and sent
+// as is to every client asking for that frame
+static const int BMP_HEADER_SIZE = 54;
+static const int BMP_ROW_SIZE = (REQUEST_IMAGE_WIDTH * 3 + 3) & ~3;
+static const int BMP_FILE_SIZE =
+    BMP_HEADER_SIZE + BMP_ROW_SIZE * REQUEST_IMAGE_HEIGHT;
+// Scaled BMPs (<web_path>.bmp?scale=N) are streamed in chunks of this size
+static const int BMP_CHUNK_SIZE = 1024;
+static const int BMP_MAX_SCALE = 20; // 640x480
+struct ThermalBmp {
+  uint32_t sequence{0}; // ThermalImage::sequence it was encoded from
+  uint8_t data[BMP_FILE_SIZE];
+};
+// Latest, one being encoded, and one for a client still sending the previous
+static const uint8_t BMP_POOL_SIZE = 3;
+using ThermalBmpPool = FramePool<ThermalBmp, BMP_POOL_SIZE>;
+#endif
+
+// Extracted calibration as persisted in flash. Bump CALIBRATION_CACHE_VERSION
+// whenever paramsMLX90640 or the extraction changes.
+static const uint32_t CALIBRATION_CACHE_VERSION = 2;
+struct MLX90640CalibrationCache {
+  uint32_t version;
+  uint16_t device_id[3];
+  uint32_t eeprom_hash; // device-level calibration words 0x2410..0x243F
+  paramsMLX90640 params;
+};
+
+#ifdef USE_MLX90640_WEB_SERVER
+esp_err_t mlx90640_web_server_handler(httpd_req_t *req);
+esp_err_t mlx90640_raw_handler(httpd_req_t *req);
+esp_err_t mlx90640_json_handler(httpd_req_t *req);
+esp_err_t mlx90640_page_handler(httpd_req_t *req);
+esp_err_t mlx90640_stream_handler(httpd_req_t *req);
+#endif
+
+// Each instance owns its I2C driver context, calibration and frame buffers, so
+// several sensors can run on one node (up to MLX90640_MAX_DEVICES), on
+// different addresses or on different buses.
+//
+// Per sensor, all allocated with the component at boot:
+//   calibration       mlx90640_params_ 4.7 KB, plus the tables of the To
+//                     kernel: 12.3 KB float, 17 KB vectorize, none fixed_point
+//   frames            3 x 3.1 KB handoff, 3.1 KB subpage target, 1.7 KB raw
+//   images            4 x 3.8 KB pool, RGB565, palette index, centi-degrees
+//   statistics        3.1 KB percentile scratch
+//   web server        3 x 2.4 KB encoded BMP pool
+// about 57 KB with the scalar float kernel (12 KB less with fixed_point),
+// plus a 4 KB stack each for acquisition_task and the web stream.
+//
+// Per frame, the bus carries two subpages of 1664 bytes (interleaved: 832 +
+// 128) plus a few status polls: about 75 ms at 400 kHz, 30 ms at 1 MHz, with
+// sensors sharing a bus taking turns. Conversion is one To kernel pass per
+// subpage. Both are logged per frame at VERBOSE level.
 class MLX90640Component : public PollingComponent, public i2c::I2CDevice {
 public:
 #ifdef USE_MLX90640_WEB_SERVER
@@ -48,46 +160,292 @@ public:
   }
   void set_median_temperature_sensor(sensor::Sensor *s) {
     median_temperature_sensor_ = s;
+    this->add_percentile_sensor(50.0f, s);
+  }
+  void add_percentile_sensor(float percentile, sensor::Sensor *s);
+  // Hot-spot detection, see BlobDetector
+  void set_blobs(float threshold, uint16_t min_area) {
+    if (blobs_ == nullptr)
+      blobs_.reset(new BlobDetector);
+    blobs_->set_threshold(threshold);
+    blobs_->set_min_area(min_area);
   }
+  void set_blob_count_sensor(sensor::Sensor *s) { blob_count_sensor_ = s; }
+  void set_blob_largest_area_sensor(sensor::Sensor *s) {
+    blob_largest_area_sensor_ = s;
+  }
+  void set_blob_centroid_x_sensor(sensor::Sensor *s) {
+    blob_centroid_x_sensor_ = s;
+  }
+  void set_blob_centroid_y_sensor(sensor::Sensor *s) {
+    blob_centroid_y_sensor_ = s;
+  }
+  void set_blob_peak_temperature_sensor(sensor::Sensor *s) {
+    blob_peak_temperature_sensor_ = s;
+  }
+  // Zone of the frame with its own sensors, any of which may be null
+  void add_region(int x, int y, int width, int height, sensor::Sensor *min,
+                  sensor::Sensor *max, sensor::Sensor *mean);
+  // Same, for a pixel mask anchored at (x, y), see ThermalRegions::add_mask
+  void add_region_mask(int x, int y, const std::vector<std::string> &rows,
+                       sensor::Sensor *min, sensor::Sensor *max,
+                       sensor::Sensor *mean);
 
   void set_emissivity(float emissivity) { emissivity_ = emissivity; }
   void set_refresh_rate(int refresh_rate) { refresh_rate_ = refresh_rate; }
+  // ADC resolution in bits, 16-19; 0 keeps the EEPROM setting. With the
+  // governor it is the ceiling of the resolutions the governor picks.
+  void set_resolution(int bits) {
+    resolution_ = bits > 0 ? bits - 16 : -1;
+    governor_.set_max_resolution(bits > 0 ? bits - 16 : 3);
+  }
+  // Governor targets; either enables it. It then picks the refresh rate,
+  // resolution (up to set_resolution()) and update interval, see
+  // AcquisitionGovernor.
+  void set_max_latency(uint32_t ms) {
+    governor_.set_max_latency(ms);
+    governor_enabled_ = true;
+  }
+  void set_max_cpu(float fraction) {
+    governor_.set_max_cpu(fraction);
+    governor_enabled_ = true;
+  }
+  void set_governor_refresh_rate_sensor(sensor::Sensor *s) {
+    governor_refresh_rate_sensor_ = s;
+  }
+  void set_governor_resolution_sensor(sensor::Sensor *s) {
+    governor_resolution_sensor_ = s;
+  }
+  void set_governor_frame_time_sensor(sensor::Sensor *s) {
+    governor_frame_time_sensor_ = s;
+  }
+  void set_governor_cpu_usage_sensor(sensor::Sensor *s) {
+    governor_cpu_usage_sensor_ = s;
+  }
+  void set_fixed_point(bool fixed_point) { fixed_point_ = fixed_point; }
+  void set_fast_math(bool fast_math) { fast_math_ = fast_math; }
+  void set_vectorize(bool vectorize) { vectorize_ = vectorize; }
+  void set_interleaved(bool interleaved) { interleaved_ = interleaved; }
+#ifdef USE_MLX90640_WEB_SERVER
+  // URL path prefix; this sensor serves <web_path>.bmp, .raw and .json, and
+  // a viewer page at <web_path>
+  void set_web_path(const std::string &web_path) { web_path_ = web_path; }
+  // multipart/x-mixed-replace stream at <web_path>/stream; 0 fps is every
+  // frame
+  void set_stream_max_clients(uint8_t n) { stream_max_clients_ = n; }
+  void set_stream_max_fps(float fps) { stream_max_fps_ = fps; }
+#endif
+  // I2C clocks in kHz for the EEPROM dump and for frame reads; 0 keeps the
+  // bus frequency
+  void set_setup_frequency(int khz) { setup_frequency_ = khz; }
+  void set_stream_frequency(int khz) { stream_frequency_ = khz; }
+  void set_acquisition_task(bool acquisition_task) {
+    acquisition_task_ = acquisition_task;
+  }
+  // Read on demand: the sensor keeps measuring, but frames are only read and
+  // converted when a consumer asks, and served up to frame_cache_ms old
+  // without reading again
+  void set_on_demand(bool on_demand) { on_demand_ = on_demand; }
+  void set_frame_cache(uint32_t ms) { frame_cache_ms_ = ms; }
   void set_min_image_temp(float t) { min_image_temp_ = t; }
   void set_max_image_temp(float t) { max_image_temp_ = t; }
+  // ThermalPalette
+  void set_palette(uint8_t palette) { palette_ = palette; }
+  // Image range follows the scene instead of mintemp/maxtemp, see AutoRange
+  void set_auto_range(bool equalize, float clip, uint32_t smoothing_ms) {
+    if (auto_range_ == nullptr)
+      auto_range_.reset(new AutoRange);
+    auto_range_->set_equalize(equalize);
+    auto_range_->set_clip(clip);
+    auto_range_->set_smoothing(smoothing_ms);
+  }
 
-  // Method to get the latest image data
-  void get_image_data(std::vector<uint8_t> &data);
+  // Latest rendered image, read in place from any task without copying or
+  // locking. Empty before the first frame.
+  ThermalImagePool::Ref get_image() { return images_.latest(); }
+  // With on_demand, whether the latest image is recent enough to serve
+  // without a new capture; always true otherwise. Any task.
+  bool is_fresh(const ThermalImagePool::Ref &image) const;
+  // Asks for a capture unless the cached frame is still fresh. No-op without
+  // on_demand. Any task.
+  void request_capture();
+  // get_image(), but with on_demand first captures a new frame if the cached
+  // one is stale, blocking the calling task until it has been rendered. Not
+  // for the main loop, which renders it.
+  ThermalImagePool::Ref get_fresh_image();
 
   // Helper to get raw data for camera if needed
-  float *get_thermal_data() { return mlx90640_to_; }
+  const float *get_thermal_data() { return frame_->to; }
+  // Latest complete frame published to the sensors; sequence is 0 before the
+  // first one. Main loop only.
+  const ThermalFrame &get_frame() const { return *frame_; }
 
 protected:
 #ifdef USE_MLX90640_WEB_SERVER
+  friend esp_err_t mlx90640_web_server_handler(httpd_req_t *req);
+  friend esp_err_t mlx90640_raw_handler(httpd_req_t *req);
+  friend esp_err_t mlx90640_json_handler(httpd_req_t *req);
   bool stream_server_started_{false};
+  std::string web_path_{"/thermal"};
+  // Encoded images for /thermal.bmp. httpd workers read them lock-free; the
+  // mutex only keeps two of them from encoding the same frame at once.
+  ThermalBmpPool bmps_;
+  std::mutex bmp_mutex_;
+  uint32_t boot_id_{0}; // keeps ETags from one boot matching the next
+  ThermalBmpPool::Ref encoded_bmp_(const ThermalImage &image);
+
+  // Stream clients are async requests handed from the httpd task to the
+  // stream task through stream_queue_; only the stream task sends to them
+  friend esp_err_t mlx90640_stream_handler(httpd_req_t *req);
+  uint8_t stream_max_clients_{2};
+  float stream_max_fps_{0.0f};
+  std::atomic<uint8_t> stream_clients_{0};
+  QueueHandle_t stream_queue_{nullptr};
+  TaskHandle_t stream_task_handle_{nullptr};
+  void start_stream_(httpd_handle_t server);
+  static void stream_task_fn_(void *param);
+  void send_stream_frame_(std::vector<httpd_req_t *> &clients,
+                          std::vector<uint32_t> &sent);
 #endif
-  std::mutex image_lock_;
   sensor::Sensor *min_temperature_sensor_{nullptr};
   sensor::Sensor *max_temperature_sensor_{nullptr};
   sensor::Sensor *mean_temperature_sensor_{nullptr};
   sensor::Sensor *median_temperature_sensor_{nullptr};
 
+  // Percentile sensors (median included), kept in ascending order
+  struct PercentileSensor {
+    float percentile;
+    sensor::Sensor *sensor;
+  };
+  std::vector<PercentileSensor> percentile_sensors_;
+  // Finite pixels of the frame for nth_element, so update() never allocates
+  float percentile_scratch_[768];
+
+  struct RegionSensors {
+    sensor::Sensor *min;
+    sensor::Sensor *max;
+    sensor::Sensor *mean;
+  };
+  void add_region_sensors_(int id, const RegionSensors &sensors);
+  // Only allocated with the first region (~6.5 KB)
+  std::unique_ptr<ThermalRegions> regions_;
+  std::vector<RegionSensors> region_sensors_; // by region id
+
+  // Only allocated when blobs are configured (~4.6 KB)
+  std::unique_ptr<BlobDetector> blobs_;
+  sensor::Sensor *blob_count_sensor_{nullptr};
+  sensor::Sensor *blob_largest_area_sensor_{nullptr};
+  sensor::Sensor *blob_centroid_x_sensor_{nullptr};
+  sensor::Sensor *blob_centroid_y_sensor_{nullptr};
+  sensor::Sensor *blob_peak_temperature_sensor_{nullptr};
+
   float emissivity_{0.95};
   int refresh_rate_{2}; // Default 2Hz
+  int8_t resolution_{-1}; // ADC resolution code, -1 to leave it alone
+  bool fixed_point_{false}; // Integer To kernel for cores without an FPU
+  bool fast_math_{false};   // Approximate fourth roots, <= 0.03 C error
+  bool vectorize_{false};   // 4-lane To kernel over subpage-grouped tables
+  bool acquisition_task_{false}; // Acquire in a pinned FreeRTOS task
+  bool interleaved_{false}; // Interleaved mode, reads only the live rows
+  bool on_demand_{false};   // Read on demand, see set_on_demand()
+  uint32_t frame_cache_ms_{1000};
+  int setup_frequency_{0};
+  int stream_frequency_{0};
   float min_image_temp_{0.0f};
   float max_image_temp_{300.0f};
+  uint8_t palette_{0};
+  // Only allocated when auto_range is configured (~2.7 KB)
+  std::unique_ptr<AutoRange> auto_range_;
 
   // MLX90640 Driver Data
+  uint8_t handle_{0}; // driver context from MLX90640_SetDevice, the API's slaveAddr
   paramsMLX90640 mlx90640_params_;
+  // Frame-invariant per-pixel tables, built once from mlx90640_params_. The
+  // float tables are only allocated for the scalar float kernels (~12 KB).
+  std::unique_ptr<compiledMLX90640> mlx90640_compiled_;
+  fixedMLX90640 mlx90640_fixed_;
+  // Only allocated when vectorize_ is set (~17 KB)
+  std::unique_ptr<vectorMLX90640> mlx90640_vector_;
   // ee_mlx90640 not used typically? Driver uses its own buffer or we pass one?
   // MLX90640_DumpEE writes to array.
 
+  // Subpage conversion target; only copied to frame_ once both halves are in
   float mlx90640_to_[768];
+  float subpage_ta_[2];
+  // Completed frames, handed from the acquisition side to the main loop
+  TripleBuffer<ThermalFrame> frames_;
+  const ThermalFrame *frame_{frames_.read()};
+  uint32_t frame_sequence_{0};
   uint16_t mlx90640_frame_[834];
 
-  // Image buffer (RGB565)
-  std::vector<uint8_t> image_buffer_;
+  // Rendered images (RGB565)
+  ThermalImagePool images_;
+  uint32_t log_skipper_{0}; // center pixel debug log, every 4th image
+
+  // Calibration cache, see MLX90640CalibrationCache
+  ESPPreferenceObject calibration_pref_;
+  uint16_t device_id_[3]{};
+  uint32_t eeprom_hash_{0};
+  bool calibration_cached_{false};
+
+  bool load_calibration_();
+  bool read_calibration_();
+  void save_calibration_();
+  void compile_calibration_();
+  float calculate_subpage_();
+  void complete_frame_();
+  void publish_frame_();
+
+  // Frame acquisition, advanced one step per loop() so the main loop never
+  // waits on the sensor
+  enum class AcquisitionState : uint8_t {
+    IDLE,
+    WAIT_READY,
+    READ_PIXELS,
+    READ_AUX,
+    COMPUTE,
+  };
+  AcquisitionState acquisition_state_{AcquisitionState::IDLE};
+  uint32_t acquisition_started_{0}; // millis() when the data-ready wait began
+  uint16_t status_register_{0};
+  uint8_t subpages_{0};      // bit per subpage converted into mlx90640_to_
+  uint8_t subpage_reads_{0};
+  uint8_t acquisition_failures_{0};
+  MLX90640_I2CStats frame_i2c_start_{}; // driver totals when the frame began
+  uint32_t frame_compute_us_{0};        // conversion time of the frame so far
+  uint8_t rate_code_{2};                // refresh-rate code on the sensor
+
+  // Runs on the acquisition side; decisions reach the main loop in frames
+  AcquisitionGovernor governor_;
+  bool governor_enabled_{false};
+  sensor::Sensor *governor_refresh_rate_sensor_{nullptr};
+  sensor::Sensor *governor_resolution_sensor_{nullptr};
+  sensor::Sensor *governor_frame_time_sensor_{nullptr};
+  sensor::Sensor *governor_cpu_usage_sensor_{nullptr};
+  // Written by the acquisition side, mirrored into the status flags by loop()
+  std::atomic<bool> acquisition_healthy_{true};
+  // On demand: set by any consumer, cleared when a frame completes
+  std::atomic<bool> capture_requested_{false};
+  std::atomic<uint32_t> last_capture_{0}; // millis() of the last frame
+#ifdef USE_ESP32
+  // On demand: given by publish_frame_() for get_fresh_image() waiters
+  SemaphoreHandle_t image_ready_{nullptr};
+  TaskHandle_t acquisition_task_handle_{nullptr};
+  static void acquisition_task_fn_(void *param);
+#else
+  void *acquisition_task_handle_{nullptr};
+#endif
+
+  void start_frame_();
+  void wake_acquisition_();
+  void clear_data_ready_();
+  void acquisition_step_();
+  void acquisition_failed_(const char *step, int error);
+  uint32_t data_ready_timeout_() const;
 
   void set_refresh_rate_hw_();
+  void apply_governor_();
+  void publish_governor_(const GovernorDecision &decision);
 };
 
 // Define this to enable web server image handler
@@ -100,13 +458,14 @@ public:
   void setup() override;
   void loop() override;
   void request_image(camera::CameraRequester requester) override;
-};
-#endif
 
-#ifdef USE_MLX90640_WEB_SERVER
-#include <esp_http_server.h>
-// Handler for serving BMP image
-esp_err_t mlx90640_web_server_handler(httpd_req_t *req);
+protected:
+  void send_image_(camera::CameraRequester requester);
+
+  // On demand: a request waiting for the capture it triggered
+  bool pending_{false};
+  camera::CameraRequester pending_requester_;
+};
 #endif
 
 } // namespace mlx90640
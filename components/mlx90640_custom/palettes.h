@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace mlx90640 {
+
+enum ThermalPalette : uint8_t {
+  PALETTE_RAINBOW = 0,
+  PALETTE_IRONBOW,
+  PALETTE_GRAYSCALE,
+  PALETTE_WHITE_HOT,
+  PALETTE_COUNT,
+};
+
+static const int PALETTE_SIZE = 256;
+
+// A colour map in the formats its consumers send: big-endian RGB565 for the
+// camera and BGR888 for BMP, so neither converts per pixel
+struct PaletteTable {
+  uint8_t rgb565[PALETTE_SIZE][2];
+  uint8_t bgr888[PALETTE_SIZE][3];
+};
+
+// Palette from Chill-Division/M5Stack-ESPHome
+static constexpr uint16_t camColors[256] = {
+    0x480F, 0x400F, 0x400F, 0x400F, 0x4010, 0x3810, 0x3810, 0x3810, 0x3810,
+    0x3010, 0x3010, 0x3010, 0x2810, 0x2810, 0x2810, 0x2810, 0x2010, 0x2010,
+    0x2010, 0x1810, 0x1810, 0x1811, 0x1811, 0x1011, 0x1011, 0x1011, 0x0811,
+    0x0811, 0x0811, 0x0011, 0x0011, 0x0011, 0x0011, 0x0011, 0x0031, 0x0031,
+    0x0051, 0x0072, 0x0072, 0x0092, 0x00B2, 0x00B2, 0x00D2, 0x00F2, 0x00F2,
+    0x0112, 0x0132, 0x0152, 0x0152, 0x0172, 0x0192, 0x0192, 0x01B2, 0x01D2,
+    0x01F3, 0x01F3, 0x0213, 0x0233, 0x0253, 0x0253, 0x0273, 0x0293, 0x02B3,
+    0x02D3, 0x02D3, 0x02F3, 0x0313, 0x0333, 0x0333, 0x0353, 0x0373, 0x0394,
+    0x03B4, 0x03D4, 0x03D4, 0x03F4, 0x0414, 0x0434, 0x0454, 0x0474, 0x0474,
+    0x0494, 0x04B4, 0x04D4, 0x04F4, 0x0514, 0x0534, 0x0534, 0x0554, 0x0554,
+    0x0574, 0x0574, 0x0573, 0x0573, 0x0573, 0x0572, 0x0572, 0x0572, 0x0571,
+    0x0591, 0x0591, 0x0590, 0x0590, 0x058F, 0x058F, 0x058F, 0x058E, 0x05AE,
+    0x05AE, 0x05AD, 0x05AD, 0x05AD, 0x05AC, 0x05AC, 0x05AB, 0x05CB, 0x05CB,
+    0x05CA, 0x05CA, 0x05CA, 0x05C9, 0x05C9, 0x05C8, 0x05E8, 0x05E8, 0x05E7,
+    0x05E7, 0x05E6, 0x05E6, 0x05E6, 0x05E5, 0x05E5, 0x0604, 0x0604, 0x0604,
+    0x0603, 0x0603, 0x0602, 0x0602, 0x0601, 0x0621, 0x0621, 0x0620, 0x0620,
+    0x0620, 0x0620, 0x0E20, 0x0E20, 0x0E40, 0x1640, 0x1640, 0x1E40, 0x1E40,
+    0x2640, 0x2640, 0x2E40, 0x2E60, 0x3660, 0x3660, 0x3E60, 0x3E60, 0x3E60,
+    0x4660, 0x4660, 0x4E60, 0x4E80, 0x5680, 0x5680, 0x5E80, 0x5E80, 0x6680,
+    0x6680, 0x6E80, 0x6EA0, 0x76A0, 0x76A0, 0x7EA0, 0x7EA0, 0x86A0, 0x86A0,
+    0x8EA0, 0x8EC0, 0x96C0, 0x96C0, 0x9EC0, 0x9EC0, 0xA6C0, 0xAEC0, 0xAEC0,
+    0xB6E0, 0xB6E0, 0xBEE0, 0xBEE0, 0xC6E0, 0xC6E0, 0xCEE0, 0xCEE0, 0xD6E0,
+    0xD700, 0xDF00, 0xDEE0, 0xDEC0, 0xDEA0, 0xDE80, 0xDE80, 0xE660, 0xE640,
+    0xE620, 0xE600, 0xE5E0, 0xE5C0, 0xE5A0, 0xE580, 0xE560, 0xE540, 0xE520,
+    0xE500, 0xE4E0, 0xE4C0, 0xE4A0, 0xE480, 0xE460, 0xEC40, 0xEC20, 0xEC00,
+    0xEBE0, 0xEBC0, 0xEBA0, 0xEB80, 0xEB60, 0xEB40, 0xEB20, 0xEB00, 0xEAE0,
+    0xEAC0, 0xEAA0, 0xEA80, 0xEA60, 0xEA40, 0xF220, 0xF200, 0xF1E0, 0xF1C0,
+    0xF1A0, 0xF180, 0xF160, 0xF140, 0xF100, 0xF0E0, 0xF0C0, 0xF0A0, 0xF080,
+    0xF060, 0xF040, 0xF020, 0xF800,
+};
+
+struct PaletteStop {
+  uint8_t r, g, b;
+};
+
+// Evenly spaced gradient stops, black to white
+static constexpr PaletteStop IRONBOW_STOPS[] = {
+    {0, 0, 0},       {32, 0, 140},    {204, 0, 119},
+    {255, 140, 0},   {255, 230, 0},   {255, 255, 255},
+};
+static constexpr PaletteStop GRAYSCALE_STOPS[] = {{0, 0, 0}, {255, 255, 255}};
+
+static constexpr PaletteStop palette_gradient(const PaletteStop *stops,
+                                              int count, int i) {
+  int pos = i * (count - 1) * 256 / (PALETTE_SIZE - 1); // Q8
+  int k = pos >> 8 < count - 1 ? pos >> 8 : count - 2;
+  int f = pos - k * 256;
+  return {(uint8_t)((stops[k].r * (256 - f) + stops[k + 1].r * f + 128) >> 8),
+          (uint8_t)((stops[k].g * (256 - f) + stops[k + 1].g * f + 128) >> 8),
+          (uint8_t)((stops[k].b * (256 - f) + stops[k + 1].b * f + 128) >> 8)};
+}
+
+static constexpr PaletteStop palette_colour(ThermalPalette palette, int i) {
+  switch (palette) {
+  case PALETTE_IRONBOW:
+    return palette_gradient(IRONBOW_STOPS, 6, i);
+  case PALETTE_GRAYSCALE:
+    return palette_gradient(GRAYSCALE_STOPS, 2, i);
+  case PALETTE_WHITE_HOT: {
+    // Grey with a squared ramp: a dark, quiet background and hot objects
+    // standing out in white
+    uint8_t v = (uint8_t)((i * i + 127) / 255);
+    return {v, v, v};
+  }
+  default: {
+    // Legacy table, expanded with rounding
+    uint16_t c = camColors[i];
+    return {(uint8_t)(((c >> 11) * 255 + 15) / 31),
+            (uint8_t)((((c >> 5) & 0x3F) * 255 + 31) / 63),
+            (uint8_t)(((c & 0x1F) * 255 + 15) / 31)};
+  }
+  }
+}
+
+static constexpr PaletteTable make_palette(ThermalPalette palette) {
+  PaletteTable table{};
+  for (int i = 0; i < PALETTE_SIZE; i++) {
+    PaletteStop c = palette_colour(palette, i);
+    uint16_t rgb565 = palette == PALETTE_RAINBOW
+                          ? camColors[i]
+                          : (uint16_t)(((c.r >> 3) << 11) | ((c.g >> 2) << 5) |
+                                       (c.b >> 3));
+    table.rgb565[i][0] = (uint8_t)(rgb565 >> 8);
+    table.rgb565[i][1] = (uint8_t)(rgb565 & 0xFF);
+    table.bgr888[i][0] = c.b;
+    table.bgr888[i][1] = c.g;
+    table.bgr888[i][2] = c.r;
+  }
+  return table;
+}
+
+// Generated at compile time into flash, in ThermalPalette order
+static constexpr PaletteTable PALETTES[PALETTE_COUNT] = {
+    make_palette(PALETTE_RAINBOW),
+    make_palette(PALETTE_IRONBOW),
+    make_palette(PALETTE_GRAYSCALE),
+    make_palette(PALETTE_WHITE_HOT),
+};
+
+} // namespace mlx90640
+} // namespace esphome
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace mlx90640 {
+
+// Min, max and mean of up to MAX_REGIONS zones of the 32x24 frame, each a
+// rectangle or a pixel mask. One pass per frame builds a summed-area table,
+// from which every rectangle's mean is four lookups, and updates the min and
+// max of the zones each pixel belongs to, so a zone costs about its own
+// pixels rather than another pass over the frame.
+class ThermalRegions {
+public:
+  static const uint8_t MAX_REGIONS = 16;
+  static const int WIDTH = 32;
+  static const int HEIGHT = 24;
+
+  struct Stats {
+    float min{NAN};
+    float max{NAN};
+    float mean{NAN};
+  };
+
+  // Returns the region's id, or -1 when all are taken or it is empty
+  int add_rect(int x, int y, int width, int height) {
+    int id = this->add_(x, y, x + width, y + height, true);
+    if (id < 0)
+      return id;
+    const Region &region = this->regions_[id];
+    for (int row = region.y0; row < region.y1; row++)
+      for (int col = region.x0; col < region.x1; col++)
+        this->members_[row * WIDTH + col] |= 1 << id;
+    return id;
+  }
+  // Rows of the mask from (x, y) down; '.' or ' ' leaves a pixel out, any
+  // other character takes it in
+  int add_mask(int x, int y, const std::vector<std::string> &rows) {
+    int x1 = x, y1 = y;
+    for (int row = 0; row < (int)rows.size(); row++)
+      for (int col = 0; col < (int)rows[row].size(); col++)
+        if (in_mask_(rows[row][col])) {
+          x1 = std::max(x1, x + col + 1);
+          y1 = std::max(y1, y + row + 1);
+        }
+    int id = this->add_(x, y, x1, y1, false);
+    if (id < 0)
+      return id;
+    for (int row = std::max(-y, 0); row < (int)rows.size() && y + row < HEIGHT;
+         row++)
+      for (int col = std::max(-x, 0);
+           col < (int)rows[row].size() && x + col < WIDTH; col++)
+        if (in_mask_(rows[row][col]))
+          this->members_[(y + row) * WIDTH + x + col] |= 1 << id;
+    return id;
+  }
+  uint8_t size() const { return this->count_; }
+
+  // The pass over a frame, row-major like ThermalFrame::to
+  void update(const float *to) {
+    for (uint8_t id = 0; id < this->count_; id++) {
+      this->regions_[id].min = INFINITY;
+      this->regions_[id].max = -INFINITY;
+      this->regions_[id].sum = 0;
+      this->regions_[id].valid = 0;
+    }
+    // Centi-degrees in integers, so the table is exact at any size
+    memset(this->sum_[0], 0, sizeof(this->sum_[0]));
+    memset(this->valid_[0], 0, sizeof(this->valid_[0]));
+    for (int y = 0; y < HEIGHT; y++) {
+      int32_t row_sum = 0;
+      uint16_t row_valid = 0;
+      this->sum_[y + 1][0] = 0;
+      this->valid_[y + 1][0] = 0;
+      for (int x = 0; x < WIDTH; x++) {
+        int i = y * WIDTH + x;
+        float temp = to[i];
+        bool valid = std::isfinite(temp);
+        int32_t centi = valid ? (int32_t)lroundf(temp * 100.0f) : 0;
+        row_sum += centi;
+        row_valid += valid;
+        this->sum_[y + 1][x + 1] = this->sum_[y][x + 1] + row_sum;
+        this->valid_[y + 1][x + 1] = this->valid_[y][x + 1] + row_valid;
+
+        uint16_t members = valid ? this->members_[i] : 0;
+        while (members != 0) {
+          Region &region = this->regions_[__builtin_ctz(members)];
+          members &= members - 1;
+          region.min = std::min(region.min, temp);
+          region.max = std::max(region.max, temp);
+          if (!region.rect) {
+            region.sum += centi;
+            region.valid++;
+          }
+        }
+      }
+    }
+  }
+
+  // After update(); NaN for a region without a valid pixel
+  Stats stats(uint8_t id) const {
+    const Region &region = this->regions_[id];
+    Stats stats;
+    int32_t sum = region.sum;
+    uint16_t valid = region.valid;
+    if (region.rect) {
+      sum = this->sum_[region.y1][region.x1] - this->sum_[region.y0][region.x1] -
+            this->sum_[region.y1][region.x0] + this->sum_[region.y0][region.x0];
+      valid = this->valid_[region.y1][region.x1] -
+              this->valid_[region.y0][region.x1] -
+              this->valid_[region.y1][region.x0] +
+              this->valid_[region.y0][region.x0];
+    }
+    if (valid == 0)
+      return stats;
+    stats.min = region.min;
+    stats.max = region.max;
+    stats.mean = sum / (100.0f * valid);
+    return stats;
+  }
+
+protected:
+  struct Region {
+    uint8_t x0, y0, x1, y1; // bounding box, exclusive end
+    bool rect;
+    float min, max;
+    int32_t sum;    // masks only; rectangles use the table
+    uint16_t valid;
+  };
+
+  static bool in_mask_(char c) { return c != '.' && c != ' '; }
+
+  int add_(int x0, int y0, int x1, int y1, bool rect) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, WIDTH);
+    y1 = std::min(y1, HEIGHT);
+    if (this->count_ >= MAX_REGIONS || x0 >= x1 || y0 >= y1)
+      return -1;
+    Region &region = this->regions_[this->count_];
+    region = Region{(uint8_t)x0, (uint8_t)y0, (uint8_t)x1, (uint8_t)y1, rect,
+                    NAN, NAN, 0, 0};
+    return this->count_++;
+  }
+
+  Region regions_[MAX_REGIONS];
+  uint8_t count_{0};
+  uint16_t members_[WIDTH * HEIGHT]{}; // bit per region covering the pixel
+  // Summed-area tables with a zero row and column in front
+  int32_t sum_[HEIGHT + 1][WIDTH + 1];
+  uint16_t valid_[HEIGHT + 1][WIDTH + 1];
+};
+
+} // namespace mlx90640
+} // namespace esphome
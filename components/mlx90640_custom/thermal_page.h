@@ -0,0 +1,59 @@
+#pragma once
+
+namespace esphome {
+namespace mlx90640 {
+
+// Viewer served at <web_path>. It polls <web_path>.raw and colours the
+// centi-degree frame in the browser, so viewers cost the ESP no rendering;
+// unchanged frames come back as 304s through the ETag.
+static const char THERMAL_PAGE_HTML[] = R"html(<!DOCTYPE html>
+<html><head><meta charset="utf-8">
+<meta name="viewport" content="width=device-width,initial-scale=1">
+<title>Thermal camera</title>
+<style>
+body{margin:0;background:#111;color:#ccc;font:14px sans-serif;text-align:center}
+canvas{width:min(96vw,128vh);image-rendering:pixelated;margin-top:1vh}
+</style></head><body>
+<canvas id="c" width="32" height="24"></canvas><div id="s"></div>
+<script>
+const raw = location.pathname.replace(/\/$/, '') + '.raw';
+const ctx = document.getElementById('c').getContext('2d');
+const img = ctx.createImageData(32, 24);
+// Ironbow: black, indigo, magenta, orange, yellow, white
+const stops = [[0,0,0],[32,0,140],[204,0,119],[255,140,0],[255,230,0],[255,255,255]];
+const pal = [];
+for (let i = 0; i < 256; i++) {
+  const p = i / 255 * (stops.length - 1), k = Math.min(Math.floor(p), stops.length - 2), f = p - k;
+  pal.push(stops[k].map((v, j) => Math.round(v + (stops[k + 1][j] - v) * f)));
+}
+const INVALID = -32768;
+async function tick() {
+  try {
+    const r = await fetch(raw, {cache: 'no-cache'});
+    if (r.ok) {
+      const view = new DataView(await r.arrayBuffer());
+      const t = new Array(768);
+      let lo = Infinity, hi = -Infinity;
+      for (let i = 0; i < 768; i++) {
+        t[i] = view.getInt16(i * 2, true);
+        if (t[i] != INVALID) { lo = Math.min(lo, t[i]); hi = Math.max(hi, t[i]); }
+      }
+      const k = 255 / Math.max(hi - lo, 1);
+      for (let i = 0; i < 768; i++) {
+        const p = pal[t[i] == INVALID ? 255 : Math.round((t[i] - lo) * k)];
+        img.data.set([p[0], p[1], p[2], 255], i * 4);
+      }
+      ctx.putImageData(img, 0, 0);
+      document.getElementById('s').textContent =
+          (lo / 100).toFixed(1) + ' – ' + (hi / 100).toFixed(1) + ' °C, Ta ' +
+          r.headers.get('X-Thermal-Ta') + ' °C, frame ' + r.headers.get('X-Thermal-Sequence');
+    }
+  } catch (e) {}
+  setTimeout(tick, 250);
+}
+tick();
+</script></body></html>
+)html";
+
+} // namespace mlx90640
+} // namespace esphome
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace esphome {
+namespace mlx90640 {
+
+// Lock-free single-producer / single-consumer handoff of the latest value.
+// The producer fills write_buffer() and calls publish(); the consumer calls
+// read() and gets the most recently published buffer. Neither side ever
+// waits: the producer always owns one buffer, the consumer one, and the third
+// is swapped between them through a single atomic byte.
+template<typename T> class TripleBuffer {
+public:
+  // Producer side
+  T *write_buffer() { return &this->buffers_[this->write_]; }
+  void publish() {
+    uint8_t previous =
+        this->shared_.exchange(this->write_ | FRESH, std::memory_order_acq_rel);
+    this->write_ = previous & INDEX;
+  }
+
+  // Consumer side. The returned buffer stays valid until the next read().
+  bool has_new() const {
+    return (this->shared_.load(std::memory_order_acquire) & FRESH) != 0;
+  }
+  const T *read() {
+    if (this->has_new()) {
+      uint8_t previous =
+          this->shared_.exchange(this->read_, std::memory_order_acq_rel);
+      this->read_ = previous & INDEX;
+    }
+    return &this->buffers_[this->read_];
+  }
+
+protected:
+  static constexpr uint8_t INDEX = 0x03;
+  static constexpr uint8_t FRESH = 0x04;
+
+  T buffers_[3]{};
+  uint8_t write_{0};
+  std::atomic<uint8_t> shared_{1};
+  uint8_t read_{2};
+};
+
+} // namespace mlx90640
+} // namespace esphome
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Writes recordings/synthetic*.rec, the recordings the host tests replay.
+
+The EEPROM carries the device-level calibration words of the MLX90640
+datasheet's worked example, with seeded occ/acc rows and columns and per-pixel
+words, so ExtractParameters sees a real sensor's scales and signs. Its
+subpages cover both subpages in chess and interleaved mode, at raw pixel
+levels from a cold to a hot scene (about -40 to 300 degC at emissivity 1), so
+every range of the To kernels is exercised. The steep_ksto variant swaps in
+KsTo of -0.0012, near the steepest slope seen on real parts, where the rough
+To that picks the range matters most.
+
+Recordings taken from a real sensor (see recording.h for the format) can be
+passed to the tests next to this one.
+"""
+
+import random
+import struct
+import sys
+from pathlib import Path
+
+SEED = 90640
+
+# Device-level words of the datasheet example, by EEPROM index
+EEPROM_WORDS = {
+    10: 0x0000,  # chess calibration
+    16: 0x4210, 17: 0xFFBB,  # occ scales, pixel offset reference
+    32: 0x79A6, 33: 0x2F44,  # acc scales, alpha reference
+    48: 0x18EF, 49: 0x2FF1, 50: 0x5952, 51: 0x9D68,  # gain, PTAT, Vdd
+    52: 0x5454, 53: 0x0994, 54: 0x6956, 55: 0x5354,  # Kv, Kta, IL chess
+    56: 0x2363, 57: 0xE446, 58: 0xFBB5, 59: 0x044B,  # CP, KsTa, resolution
+    60: 0xF020, 61: 0x9797, 62: 0x9797, 63: 0x2889,  # KsTo, corner temps
+}
+
+# Words each recording overrides, by file name
+RECORDINGS = {
+    "synthetic.rec": {},
+    "synthetic_steep_ksto.rec": {61: 0xB1B1, 62: 0xB1B1, 63: 0x2888},
+}
+
+# Raw pixel levels of the scenes, as (low, high)
+SCENES = [(-350, -100), (-300, 900), (600, 3000), (2500, 5200)]
+
+
+def nibbles(rng):
+    """A word of four small signed occ/acc nibbles."""
+    word = 0
+    for shift in (0, 4, 8, 12):
+        word |= (rng.randint(-2, 2) & 0xF) << shift
+    return word
+
+
+def eeprom(rng, overrides):
+    words = [0] * 832
+    for index, word in {**EEPROM_WORDS, **overrides}.items():
+        words[index] = word
+    for index in list(range(18, 32)) + list(range(34, 48)):
+        words[index] = nibbles(rng)
+    for pixel in range(768):
+        offset = rng.randint(-12, 12) & 0x3F
+        alpha = rng.randint(-12, 12) & 0x3F
+        kta = rng.randint(-2, 2) & 0x7
+        # Never 0 (broken) and bit 0 clear (not an outlier)
+        words[64 + pixel] = (offset << 10) | (alpha << 4) | (kta << 1) or 0x0400
+    return words
+
+
+def subpage(rng, number, chess, low, high):
+    ram = [0] * 832
+    for pixel in range(768):
+        ram[pixel] = rng.randint(low, high) & 0xFFFF
+    # Aux: VBE, CP of both subpages, gain, PTAT and Vdd of a room-temperature
+    # sensor at 3.3 V
+    ram[768 + 0] = 20617
+    ram[768 + 8] = -60 & 0xFFFF
+    ram[768 + 10] = 5800
+    ram[768 + 32] = 1720
+    ram[768 + 40] = -58 & 0xFFFF
+    ram[768 + 42] = -13200 & 0xFFFF
+    status = 0x0008 | number  # data ready, subpage
+    control = (0x1000 if chess else 0) | (2 << 10) | (3 << 7) | 1
+    return status, control, ram
+
+
+def write(path, overrides):
+    rng = random.Random(SEED)
+    words = eeprom(rng, overrides)
+    subpages = []
+    for chess in (True, False):
+        for low, high in SCENES:
+            for number in (0, 1):
+                subpages.append(subpage(rng, number, chess, low, high))
+
+    data = struct.pack("<4H", 0x4C4D, 0x5258, 1, len(subpages))
+    data += struct.pack("<832H", *words)
+    for status, control, ram in subpages:
+        data += struct.pack("<2H832H", status, control, *ram)
+    path.write_bytes(data)
+
+
+def main():
+    directory = Path(sys.argv[1] if len(sys.argv) > 1 else
+                     Path(__file__).parent / "recordings")
+    directory.mkdir(parents=True, exist_ok=True)
+    for name, overrides in RECORDINGS.items():
+        write(directory / name, overrides)
+
+
+if __name__ == "__main__":
+    main()
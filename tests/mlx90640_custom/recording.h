@@ -0,0 +1,108 @@
+#pragma once
+// Replays a recorded MLX90640 session through the real driver: the EEPROM and
+// each subpage's RAM, status and control registers, as the sensor returned
+// them over I2C.
+//
+// Recording file (.rec), all little-endian uint16:
+//   "ML" "XR", version (1), subpage count N
+//   EEPROM 0x2400-0x273F (832 words)
+//   N times: status register 0x8000, control register 0x800D,
+//            RAM 0x0400-0x073F (832 words: 768 pixels, 64 aux)
+
+#include "MLX90640_I2C_Driver.h"
+#include "MLX90640_API.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+struct RecordedSubpage {
+  uint16_t status;
+  uint16_t control;
+  uint16_t ram[832];
+};
+
+class RecordingPlayer : public esphome::i2c::I2CDevice {
+public:
+  bool load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+      return false;
+    uint16_t header[4];
+    bool ok = fread(header, 2, 4, file) == 4 && header[0] == 0x4C4D &&
+              header[1] == 0x5258 && header[2] == 1 &&
+              fread(this->eeprom, 2, 832, file) == 832;
+    if (ok) {
+      this->subpages.resize(header[3]);
+      for (auto &subpage : this->subpages)
+        ok = ok && fread(&subpage, 2, 834, file) == 834;
+    }
+    fclose(file);
+    this->next_ = 0;
+    return ok;
+  }
+
+  // Subpages not yet handed out by a status read
+  size_t remaining() const { return this->subpages.size() - this->next_; }
+
+  esphome::i2c::ErrorCode write_read(const uint8_t *write_buffer,
+                                     size_t write_count, uint8_t *read_buffer,
+                                     size_t read_count) override {
+    if (write_count != 2)
+      return esphome::i2c::ERROR_UNKNOWN;
+    unsigned address = (write_buffer[0] << 8) | write_buffer[1];
+    for (size_t i = 0; i < read_count / 2; i++) {
+      uint16_t word;
+      if (!this->word_(address + i, &word))
+        return esphome::i2c::ERROR_UNKNOWN;
+      read_buffer[i * 2] = word >> 8;
+      read_buffer[i * 2 + 1] = word & 0xFF;
+    }
+    return esphome::i2c::ERROR_OK;
+  }
+
+  esphome::i2c::ErrorCode write(const uint8_t *data, size_t len) override {
+    if (len != 4)
+      return esphome::i2c::ERROR_UNKNOWN;
+    unsigned address = (data[0] << 8) | data[1];
+    // Clearing data-ready hands the driver the pending subpage's RAM
+    if (address == MLX90640_STATUS_REG && this->next_ < this->subpages.size())
+      this->current_ = this->next_++;
+    return esphome::i2c::ERROR_OK;
+  }
+
+  uint16_t eeprom[832];
+  std::vector<RecordedSubpage> subpages;
+
+protected:
+  bool word_(unsigned address, uint16_t *word) const {
+    if (address >= MLX90640_EEPROM_START_ADDRESS &&
+        address < MLX90640_EEPROM_START_ADDRESS + 832) {
+      *word = this->eeprom[address - MLX90640_EEPROM_START_ADDRESS];
+      return true;
+    }
+    if (address == MLX90640_STATUS_REG) {
+      // Data ready while subpages are left
+      *word = this->next_ < this->subpages.size()
+                  ? this->subpages[this->next_].status
+                  : 0;
+      return true;
+    }
+    if (this->subpages.empty())
+      return false;
+    const RecordedSubpage &subpage = this->subpages[this->current_];
+    if (address == MLX90640_CTRL_REG) {
+      *word = subpage.control;
+      return true;
+    }
+    if (address >= MLX90640_PIXEL_DATA_START_ADDRESS &&
+        address < MLX90640_PIXEL_DATA_START_ADDRESS + 832) {
+      *word = subpage.ram[address - MLX90640_PIXEL_DATA_START_ADDRESS];
+      return true;
+    }
+    return false;
+  }
+
+  size_t next_{0};
+  size_t current_{0};
+};
@@ -0,0 +1,22 @@
+#pragma once
+// Host stand-in for the ESPHome I2C device the MLX90640 driver talks through.
+// The tests implement its two transfers (see recording.h).
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace i2c {
+
+enum ErrorCode { ERROR_OK = 0, ERROR_UNKNOWN = 1 };
+
+class I2CDevice {
+public:
+  virtual ~I2CDevice() = default;
+  virtual ErrorCode write_read(const uint8_t *write_buffer, size_t write_count,
+                               uint8_t *read_buffer, size_t read_count) = 0;
+  virtual ErrorCode write(const uint8_t *data, size_t len) = 0;
+  uint8_t get_i2c_address() const { return 0x33; }
+};
+
+} // namespace i2c
+} // namespace esphome
@@ -0,0 +1,12 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+namespace esphome {
+inline uint32_t micros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+inline uint32_t millis() { return micros() / 1000; }
+} // namespace esphome
@@ -0,0 +1,164 @@
+// Replays recordings through the driver and holds the optimised To kernels to
+// MLX90640_CalculateTo on every live pixel of every subpage.
+//
+//   test_to_kernels recordings/synthetic.rec [more.rec ...]
+
+#include "recording.h"
+
+#include <cmath>
+#include <cstdio>
+
+// Worst |To - reference| each kernel may show over the sensor's range, in
+// degC. Documented at the kernel in MLX90640_API.cpp.
+static const float COMPILED_BOUND = 0.0005f;
+static const float FAST_BOUND = 0.03f;
+static const float FIXED_BOUND = 0.005f;
+static const float VECTOR_BOUND = 0.002f;
+static const float MIN_TO = -40.0f;
+static const float MAX_TO = 300.0f;
+
+static const float EMISSIVITIES[] = {0.95f, 0.7f};
+// Marks the pixels a subpage leaves alone
+static const float SKIPPED = -1000.0f;
+
+static paramsMLX90640 params;
+static compiledMLX90640 compiled;
+static fixedMLX90640 fixed;
+static vectorMLX90640 vector[2]; // chess, interleaved tables
+
+struct Worst {
+  const char *kernel;
+  float bound;
+  float error{0.0f};
+  float reference{NAN};
+  int pixels{0};
+  int failures{0};
+  int outside{0}; // pixels beyond the sensor's range, not compared
+  float low{NAN}, high{NAN};
+
+  void compare(const float *reference, const float *result) {
+    for (int i = 0; i < MLX90640_PIXEL_NUM; i++) {
+      if (std::isnan(reference[i]) && std::isnan(result[i]))
+        continue;
+      if (reference[i] == SKIPPED && result[i] == SKIPPED)
+        continue;
+      if (reference[i] < MIN_TO || reference[i] > MAX_TO) {
+        this->outside++;
+        continue;
+      }
+      this->low = std::fmin(this->low, reference[i]);
+      this->high = std::fmax(this->high, reference[i]);
+      float error = std::fabs(result[i] - reference[i]);
+      this->pixels++;
+      if (!(error <= this->bound))
+        this->failures++;
+      if (!(error <= this->error)) {
+        this->error = error;
+        this->reference = reference[i];
+      }
+    }
+  }
+  bool report() const {
+    printf("%-11s %6d pixels from %.1f to %.1f degC (%d outside), worst %.4f "
+           "degC at %.2f degC, bound %.4f: %s\n",
+           this->kernel, this->pixels, this->low, this->high, this->outside,
+           this->error, this->reference, this->bound,
+           this->failures == 0 ? "ok" : "FAIL");
+    return this->failures == 0 && this->pixels > 0;
+  }
+};
+
+enum Kernel { COMPILED, FAST, FIXED, VECTOR, VECTOR_FAST, KERNELS };
+
+static bool replay(const char *path, Worst *worst) {
+  RecordingPlayer player;
+  if (!player.load(path)) {
+    printf("%s: cannot read the recording\n", path);
+    return false;
+  }
+  int handle = MLX90640_SetDevice(&player);
+  uint16_t ee_data[MLX90640_EEPROM_DUMP_NUM];
+  if (handle < 0 || MLX90640_DumpEE(handle, ee_data) != 0 ||
+      MLX90640_ExtractParameters(ee_data, &params) != 0) {
+    printf("%s: bad EEPROM\n", path);
+    return false;
+  }
+  MLX90640_CompileParameters(&params, &compiled);
+  MLX90640_CompileFixedParameters(&params, &fixed);
+  MLX90640_CompileVectorParameters(&params, 0x80, &vector[0]);
+  MLX90640_CompileVectorParameters(&params, 0x00, &vector[1]);
+
+  bool ok = true;
+  uint16_t frame[834];
+  while (player.remaining() > 0) {
+    if (MLX90640_GetFrameData(handle, frame) < 0) {
+      printf("%s: bad subpage\n", path);
+      return false;
+    }
+    float tr = MLX90640_GetTa(frame, &params) - 8.0f;
+    bool chess = (frame[832] & MLX90640_CTRL_MEAS_MODE_MASK) != 0;
+    const vectorMLX90640 *tables = &vector[chess ? 0 : 1];
+    const vectorMLX90640 *other_tables = &vector[chess ? 1 : 0];
+
+    for (float emissivity : EMISSIVITIES) {
+      float reference[MLX90640_PIXEL_NUM], result[MLX90640_PIXEL_NUM];
+      auto clear = [](float *to) {
+        for (int i = 0; i < MLX90640_PIXEL_NUM; i++)
+          to[i] = SKIPPED;
+      };
+      clear(reference);
+      MLX90640_CalculateTo(frame, &params, emissivity, tr, reference);
+
+      clear(result);
+      MLX90640_CalculateToCompiled(frame, &params, &compiled, emissivity, tr,
+                                   result);
+      worst[COMPILED].compare(reference, result);
+      clear(result);
+      MLX90640_CalculateToFast(frame, &params, &compiled, emissivity, tr,
+                               result);
+      worst[FAST].compare(reference, result);
+      clear(result);
+      MLX90640_CalculateToFixed(frame, &params, &fixed, emissivity, tr, result);
+      worst[FIXED].compare(reference, result);
+
+      for (int fast_math = 0; fast_math < 2; fast_math++) {
+        clear(result);
+        // Tables of the other mode are refused and result left alone
+        if (MLX90640_CalculateToVector(frame, &params, other_tables,
+                                       emissivity, tr, fast_math,
+                                       result) != -1 ||
+            result[0] != SKIPPED) {
+          printf("%s: vector kernel took tables of the other mode\n", path);
+          ok = false;
+        }
+        if (MLX90640_CalculateToVector(frame, &params, tables, emissivity, tr,
+                                       fast_math, result) != 0) {
+          printf("%s: vector kernel refused its own mode\n", path);
+          ok = false;
+        }
+        worst[fast_math ? VECTOR_FAST : VECTOR].compare(reference, result);
+      }
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("usage: %s recording.rec...\n", argv[0]);
+    return 2;
+  }
+  Worst worst[KERNELS] = {
+      {"compiled", COMPILED_BOUND},
+      {"fast", FAST_BOUND},
+      {"fixed", FIXED_BOUND},
+      {"vector", VECTOR_BOUND},
+      {"vector/fast", FAST_BOUND},
+  };
+  bool ok = true;
+  for (int i = 1; i < argc; i++)
+    ok = replay(argv[i], worst) && ok;
+  for (const Worst &kernel : worst)
+    ok = kernel.report() && ok;
+  return ok ? 0 : 1;
+}